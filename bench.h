@@ -0,0 +1,231 @@
+// A small harness for micro-benchmarks.
+// Header only, standard library only: every *-bench.cc is a program of
+// its own and builds with nothing but the compiler, e.g.
+//
+//   g++ -std=c++20 -O2 -march=native -pthread erat-bench.cc -o erat-bench
+//
+// Run it as
+//
+//   ./erat-bench [-o FILE.json] [-t MS] [FILTER]
+//
+// to time the benchmarks whose names contain FILTER, about MS ms each
+// (100 by default), and to write the results to FILE.json as well as to
+// the table on stdout.  The JSON has one benchmark per line, in the
+// order they ran, so the files from two commits diff well.
+
+#ifndef _GOO_BENCH_H
+#define _GOO_BENCH_H 1
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* Make the compiler believe that V is used, and that it may have been
+   read or written through memory, so the computation of V can neither
+   be dropped nor hoisted out of the timing loop.  */
+
+template<typename T>
+inline void do_not_optimize (const T &v)
+{
+  if constexpr (std::is_trivially_copyable_v<T> && sizeof (T) <= 16)
+    asm volatile ("" : : "r,m" (v) : "memory");
+  else
+    asm volatile ("" : : "m" (v) : "memory");
+}
+
+/* V, but the compiler no longer knows its value, so it can't fold the
+   work done on it into a constant.  */
+
+template<typename T>
+inline T opaque (T v)
+{
+  asm volatile ("" : "+r,m" (v));
+  return v;
+}
+
+/* FIRST, FIRST * FACTOR, FIRST * FACTOR^2, ... up to LAST: input sizes
+   to sweep over.  */
+
+inline std::vector<std::uint64_t>
+sweep (std::uint64_t first, std::uint64_t last, std::uint64_t factor = 10)
+{
+  std::vector<std::uint64_t> v;
+  for (std::uint64_t n = first; n <= last; n *= factor)
+    {
+      v.push_back (n);
+      if (n > last / factor)
+	break;
+    }
+  return v;
+}
+
+/* SplitMix64, with a fixed seed, so that every run and every commit
+   benchmarks the same inputs.  */
+
+class bench_random {
+public:
+  explicit bench_random (std::uint64_t seed = 0x2545f4914f6cdd1dull)
+    : s_(seed) {}
+
+  std::uint64_t operator() ()
+  {
+    std::uint64_t z = (s_ += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  /* Uniform in [0, N), near enough.  */
+  std::uint64_t below (std::uint64_t n)
+  {
+    return (unsigned __int128) (*this) () * n >> 64;
+  }
+
+private:
+  std::uint64_t s_;
+};
+
+class bench_suite {
+public:
+  bench_suite (const char *name, int argc, char **argv) : name_(name)
+  {
+    for (int i = 1; i < argc; ++i)
+      if (!std::strcmp (argv[i], "-o") && i + 1 < argc)
+	json_ = argv[++i];
+      else if (!std::strcmp (argv[i], "-t") && i + 1 < argc)
+	budget_ns_ = std::atof (argv[++i]) * 1e6;
+      else if (argv[i][0] == '-')
+	{
+	  std::fprintf (stderr,
+			"usage: %s [-o FILE.json] [-t MS] [FILTER]\n",
+			argv[0]);
+	  std::exit (2);
+	}
+      else
+	filter_ = argv[i];
+    std::printf ("%-36s %14s %14s %14s %12s\n", name, "size",
+		 "median ns/op", "p99 ns/op", "op/s");
+  }
+
+  ~bench_suite ()
+  {
+    if (json_)
+      write_json ();
+  }
+
+  /* Time F (), which does OPS operations on an input of SIZE.  */
+
+  template<typename F>
+  void run (const std::string &name, std::uint64_t size, std::uint64_t ops,
+	    F f)
+  {
+    if (filter_ && name.find (filter_) == std::string::npos)
+      return;
+
+    /* Warm up the caches, the branch predictors and the clock speed,
+       and find how many calls make a sample of sample_ns, doubling up
+       from one.  */
+    const double sample_ns = budget_ns_ / max_samples;
+    std::uint64_t iters = 1;
+    double t = time (f, iters);
+    double warm = t;
+    while (t < sample_ns && iters < (std::uint64_t (1) << 40))
+      {
+	iters = t > 0 ? std::max<std::uint64_t> (2 * iters,
+						 iters * sample_ns / t)
+		      : 2 * iters;
+	t = time (f, iters);
+	warm += t;
+      }
+    while (warm < budget_ns_ / 10)
+      warm += time (f, iters);
+
+    /* Slow calls get fewer samples, down to min_samples.  */
+    const int samples = std::clamp (int (budget_ns_ / t), min_samples,
+				    max_samples);
+    std::vector<double> per_op (samples);
+    for (auto &s : per_op)
+      s = time (f, iters) / (double (iters) * ops);
+    std::sort (per_op.begin (), per_op.end ());
+
+    result r { name, size, ops, iters, samples,
+	       percentile (per_op, 0.5), percentile (per_op, 0.99) };
+    std::printf ("%-36s %14llu %14.2f %14.2f %12.4g\n", name.c_str (),
+		 (unsigned long long) size, r.median, r.p99, 1e9 / r.median);
+    std::fflush (stdout);
+    results_.push_back (std::move (r));
+  }
+
+private:
+  static constexpr int min_samples = 5;
+  static constexpr int max_samples = 101;
+
+  struct result {
+    std::string name;
+    std::uint64_t size, ops, iters;
+    int samples;
+    double median, p99;
+  };
+
+  /* Nanoseconds that ITERS calls of F take.  */
+
+  template<typename F>
+  static double time (F &f, std::uint64_t iters)
+  {
+    auto t0 = std::chrono::steady_clock::now ();
+    for (std::uint64_t i = 0; i < iters; ++i)
+      f ();
+    auto t1 = std::chrono::steady_clock::now ();
+    return std::chrono::duration<double, std::nano> (t1 - t0).count ();
+  }
+
+  /* The nearest-rank Q-th percentile of the sorted V.  */
+
+  static double percentile (const std::vector<double> &v, double q)
+  {
+    std::size_t i = std::ceil (q * v.size ());
+    return v[std::max<std::size_t> (i, 1) - 1];
+  }
+
+  void write_json () const
+  {
+    std::FILE *f = std::fopen (json_, "w");
+    if (!f)
+      {
+	std::perror (json_);
+	return;
+      }
+    std::fprintf (f, "{\"suite\": \"%s\", \"compiler\": \"%s\", "
+		  "\"benchmarks\": [\n", name_, __VERSION__);
+    for (std::size_t i = 0; i < results_.size (); ++i)
+      {
+	const result &r = results_[i];
+	std::fprintf (f, "{\"name\": \"%s\", \"size\": %llu, \"ops\": %llu, "
+		      "\"iterations\": %llu, \"samples\": %d, "
+		      "\"median_ns\": %.3f, \"p99_ns\": %.3f, "
+		      "\"ops_per_s\": %.6g}%s\n",
+		      r.name.c_str (), (unsigned long long) r.size,
+		      (unsigned long long) r.ops,
+		      (unsigned long long) r.iters, r.samples, r.median,
+		      r.p99, 1e9 / r.median,
+		      i + 1 < results_.size () ? "," : "");
+      }
+    std::fprintf (f, "]}\n");
+    std::fclose (f);
+  }
+
+  const char *name_;
+  const char *json_ = nullptr;
+  const char *filter_ = nullptr;
+  double budget_ns_ = 100e6;
+  std::vector<result> results_;
+};
+
+#endif // _GOO_BENCH_H
@@ -0,0 +1,762 @@
+// Fixed-width unsigned integers, big enough for RSA.
+// Use -std=c++20.
+
+#ifndef _GOO_BIGINT_H
+#define _GOO_BIGINT_H 1
+
+#if __cplusplus > 201703L && __cpp_concepts >= 201907L
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#include "miller-rabin.h"
+
+/* Numbers are stored as arrays of 64-bit limbs, least significant limb
+   first.  The mp_ functions below work on raw limb arrays; wide_uint
+   wraps them into something that behaves like a built-in unsigned type
+   (arithmetic is mod 2^Bits).  Nothing here allocates on the heap.  */
+
+using limb = std::uint64_t;
+
+/* R = A + B, all N limbs long.  Returns the carry out.  */
+
+inline limb
+mp_add (limb *r, const limb *a, const limb *b, std::size_t n)
+{
+  limb c = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      limb s = a[i] + c;
+      c = s < c;
+      r[i] = s + b[i];
+      c += r[i] < s;
+    }
+  return c;
+}
+
+/* R = A - B, all N limbs long.  Returns the borrow out.  */
+
+inline limb
+mp_sub (limb *r, const limb *a, const limb *b, std::size_t n)
+{
+  limb c = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      limb d = a[i] - c;
+      c = a[i] < c;
+      r[i] = d - b[i];
+      c += d < b[i];
+    }
+  return c;
+}
+
+/* Add the single limb C into R[0..N).  Returns the carry out.  */
+
+inline limb
+mp_add_1 (limb *r, limb c, std::size_t n)
+{
+  for (std::size_t i = 0; i < n && c; ++i)
+    {
+      r[i] += c;
+      c = r[i] < c;
+    }
+  return c;
+}
+
+/* Compare A and B, N limbs each.  */
+
+inline int
+mp_cmp (const limb *a, const limb *b, std::size_t n)
+{
+  for (std::size_t i = n; i-- > 0; )
+    if (a[i] != b[i])
+      return a[i] < b[i] ? -1 : 1;
+  return 0;
+}
+
+/* R = A * M, all N limbs long.  Returns the high limb of the product.  */
+
+inline limb
+mp_mul_1 (limb *r, const limb *a, limb m, std::size_t n)
+{
+  using u128 = unsigned __int128;
+  limb c = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      u128 t = u128 (a[i]) * m + c;
+      r[i] = limb (t);
+      c = t >> 64;
+    }
+  return c;
+}
+
+/* R[0..2N) = A * B, schoolbook.  */
+
+inline void
+mp_mul_school (limb *r, const limb *a, const limb *b, std::size_t n)
+{
+  using u128 = unsigned __int128;
+  for (std::size_t i = 0; i < 2 * n; ++i)
+    r[i] = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      limb c = 0;
+      for (std::size_t j = 0; j < n; ++j)
+	{
+	  u128 t = u128 (a[i]) * b[j] + r[i + j] + c;
+	  r[i + j] = limb (t);
+	  c = t >> 64;
+	}
+      r[i + n] = c;
+    }
+}
+
+/* Below this many limbs schoolbook multiplication wins.  */
+inline constexpr std::size_t karatsuba_threshold = 24;
+
+/* R[0..2N) = A * B.  Karatsuba, for even N above the threshold: with
+   A = A1 X + A0 and B = B1 X + B0,
+
+     A * B = A1 B1 X^2 + (A1 B1 + A0 B0 - (A0 - A1)(B0 - B1)) X + A0 B0
+
+   so three half-size products do the job of four.  Using the difference
+   rather than the sum of the halves keeps everything within N/2 limbs.
+   The scratch space lives on the stack.  */
+
+template<std::size_t N>
+void mp_mul (limb *r, const limb *a, const limb *b)
+{
+  if constexpr (N < karatsuba_threshold || N % 2 != 0)
+    mp_mul_school (r, a, b, N);
+  else
+    {
+      constexpr std::size_t h = N / 2;
+      const limb *a0 = a, *a1 = a + h, *b0 = b, *b1 = b + h;
+
+      mp_mul<h> (r, a0, b0);
+      mp_mul<h> (r + N, a1, b1);
+
+      /* |A0 - A1| and |B0 - B1|, and the sign of their product.  */
+      limb da[h], db[h];
+      bool neg = false;
+      if (mp_cmp (a0, a1, h) >= 0)
+	mp_sub (da, a0, a1, h);
+      else
+	{
+	  mp_sub (da, a1, a0, h);
+	  neg = !neg;
+	}
+      if (mp_cmp (b0, b1, h) >= 0)
+	mp_sub (db, b0, b1, h);
+      else
+	{
+	  mp_sub (db, b1, b0, h);
+	  neg = !neg;
+	}
+      limb d[N];
+      mp_mul<h> (d, da, db);
+
+      /* MID = A0 B0 + A1 B1 -/+ D, which is never negative.  */
+      limb mid[N];
+      limb top = mp_add (mid, r, r + N, N);
+      if (neg)
+	top += mp_add (mid, mid, d, N);
+      else
+	top -= mp_sub (mid, mid, d, N);
+
+      top += mp_add (r + h, r + h, mid, N);
+      mp_add_1 (r + h + N, top, h);
+    }
+}
+
+template<std::size_t Bits>
+class wide_uint {
+  static_assert (Bits > 0 && Bits % 64 == 0);
+public:
+  static constexpr std::size_t nlimbs = Bits / 64;
+
+  std::array<limb, nlimbs> limbs{};
+
+  constexpr wide_uint () = default;
+
+  /* Converts like a built-in type would: negative values wrap.  */
+  template<std::integral T>
+  constexpr wide_uint (T v)
+  {
+    limbs[0] = limb (v);
+    if constexpr (std::is_signed_v<T>)
+      if (v < 0)
+	for (std::size_t i = 1; i < nlimbs; ++i)
+	  limbs[i] = ~limb (0);
+  }
+
+  /* Zero-extend or truncate from another width.  */
+  template<std::size_t B>
+  constexpr explicit wide_uint (const wide_uint<B> &v)
+  {
+    for (std::size_t i = 0; i < nlimbs && i < v.nlimbs; ++i)
+      limbs[i] = v.limbs[i];
+  }
+
+  constexpr explicit operator bool () const
+  {
+    for (limb l : limbs)
+      if (l)
+	return true;
+    return false;
+  }
+
+  /* The low 64 bits.  */
+  constexpr limb low () const { return limbs[0]; }
+
+  bool bit (std::size_t i) const { return (limbs[i / 64] >> (i % 64)) & 1; }
+
+  friend bool operator== (const wide_uint &, const wide_uint &) = default;
+
+  friend std::strong_ordering
+  operator<=> (const wide_uint &a, const wide_uint &b)
+  {
+    return mp_cmp (a.limbs.data (), b.limbs.data (), nlimbs) <=> 0;
+  }
+
+  wide_uint &operator+= (const wide_uint &b)
+  {
+    mp_add (limbs.data (), limbs.data (), b.limbs.data (), nlimbs);
+    return *this;
+  }
+
+  wide_uint &operator-= (const wide_uint &b)
+  {
+    mp_sub (limbs.data (), limbs.data (), b.limbs.data (), nlimbs);
+    return *this;
+  }
+
+  /* The product, truncated to Bits.  */
+  wide_uint &operator*= (const wide_uint &b)
+  {
+    using u128 = unsigned __int128;
+    wide_uint r;
+    for (std::size_t i = 0; i < nlimbs; ++i)
+      {
+	limb c = 0;
+	for (std::size_t j = 0; i + j < nlimbs; ++j)
+	  {
+	    u128 t = u128 (limbs[i]) * b.limbs[j] + r.limbs[i + j] + c;
+	    r.limbs[i + j] = limb (t);
+	    c = t >> 64;
+	  }
+      }
+    return *this = r;
+  }
+
+  wide_uint &operator<<= (std::size_t s)
+  {
+    if (s >= Bits)
+      return *this = wide_uint ();
+    const std::size_t w = s / 64, b = s % 64;
+    for (std::size_t i = nlimbs; i-- > 0; )
+      {
+	limb v = i >= w ? limbs[i - w] << b : 0;
+	if (b && i > w)
+	  v |= limbs[i - w - 1] >> (64 - b);
+	limbs[i] = v;
+      }
+    return *this;
+  }
+
+  wide_uint &operator>>= (std::size_t s)
+  {
+    if (s >= Bits)
+      return *this = wide_uint ();
+    const std::size_t w = s / 64, b = s % 64;
+    for (std::size_t i = 0; i < nlimbs; ++i)
+      {
+	limb v = i + w < nlimbs ? limbs[i + w] >> b : 0;
+	if (b && i + w + 1 < nlimbs)
+	  v |= limbs[i + w + 1] << (64 - b);
+	limbs[i] = v;
+      }
+    return *this;
+  }
+
+  wide_uint &operator&= (const wide_uint &b)
+  {
+    for (std::size_t i = 0; i < nlimbs; ++i)
+      limbs[i] &= b.limbs[i];
+    return *this;
+  }
+
+  wide_uint &operator|= (const wide_uint &b)
+  {
+    for (std::size_t i = 0; i < nlimbs; ++i)
+      limbs[i] |= b.limbs[i];
+    return *this;
+  }
+
+  wide_uint &operator/= (const wide_uint &b)
+  {
+    return *this = divmod (*this, b).first;
+  }
+
+  wide_uint &operator%= (const wide_uint &b)
+  {
+    return *this = divmod (*this, b).second;
+  }
+
+  wide_uint &operator++ () { return *this += 1; }
+  wide_uint &operator-- () { return *this -= 1; }
+
+  friend wide_uint operator+ (wide_uint a, const wide_uint &b)
+  {
+    return a += b;
+  }
+
+  friend wide_uint operator- (wide_uint a, const wide_uint &b)
+  {
+    return a -= b;
+  }
+
+  friend wide_uint operator* (wide_uint a, const wide_uint &b)
+  {
+    return a *= b;
+  }
+
+  friend wide_uint operator/ (wide_uint a, const wide_uint &b)
+  {
+    return a /= b;
+  }
+
+  friend wide_uint operator% (wide_uint a, const wide_uint &b)
+  {
+    return a %= b;
+  }
+
+  friend wide_uint operator& (wide_uint a, const wide_uint &b)
+  {
+    return a &= b;
+  }
+
+  friend wide_uint operator| (wide_uint a, const wide_uint &b)
+  {
+    return a |= b;
+  }
+
+  friend wide_uint operator<< (wide_uint a, std::size_t s) { return a <<= s; }
+  friend wide_uint operator>> (wide_uint a, std::size_t s) { return a >>= s; }
+
+  /* Return {A / B, A % B}.  Binary long division, but starting with as
+     many of A's top bits as B has, so it takes one step per bit of the
+     quotient rather than per bit of A.  */
+  friend std::pair<wide_uint, wide_uint>
+  divmod (const wide_uint &a, const wide_uint &b)
+  {
+    if (a < b)
+      return { wide_uint (), a };
+    const std::size_t na = bit_width (a), nb = bit_width (b);
+    wide_uint q, r = a >> (na - nb + 1);
+    for (std::size_t i = na - nb + 1; i-- > 0; )
+      {
+	/* R < B, so R * 2 + 1 fits unless B has the top bit set.  */
+	bool carry = r.bit (Bits - 1);
+	r <<= 1;
+	r.limbs[0] |= a.bit (i);
+	if (carry || r >= b)
+	  {
+	    r -= b;
+	    q.limbs[i / 64] |= limb (1) << (i % 64);
+	  }
+      }
+    return { q, r };
+  }
+
+  /* Divide in place by the single limb D, and return the remainder.  */
+  limb divmod_1 (limb d)
+  {
+    using u128 = unsigned __int128;
+    limb r = 0;
+    for (std::size_t i = nlimbs; i-- > 0; )
+      {
+	u128 t = (u128 (r) << 64) | limbs[i];
+	limbs[i] = t / d;
+	r = t % d;
+      }
+    return r;
+  }
+
+  /* This mod D.  */
+  limb mod_1 (limb d) const
+  {
+    using u128 = unsigned __int128;
+    limb r = 0;
+    for (std::size_t i = nlimbs; i-- > 0; )
+      r = ((u128 (r) << 64) | limbs[i]) % d;
+    return r;
+  }
+
+  /* Number of bits needed to represent A.  */
+  friend std::size_t bit_width (const wide_uint &a)
+  {
+    for (std::size_t i = nlimbs; i-- > 0; )
+      if (a.limbs[i])
+	return 64 * i + std::bit_width (a.limbs[i]);
+    return 0;
+  }
+
+  /* Number of trailing zero bits; A != 0.  */
+  friend std::size_t countr_zero (const wide_uint &a)
+  {
+    std::size_t i = 0;
+    while (a.limbs[i] == 0)
+      ++i;
+    return 64 * i + std::countr_zero (a.limbs[i]);
+  }
+
+  friend std::ostream &operator<< (std::ostream &os, wide_uint a)
+  {
+    /* log10 (2) < 10/33.  */
+    char buf[Bits * 10 / 33 + 2];
+    char *p = buf + sizeof buf;
+    *--p = '\0';
+    do
+      *--p = '0' + a.divmod_1 (10);
+    while (a);
+    return os << p;
+  }
+};
+
+template<std::size_t Bits>
+bool odd (const wide_uint<Bits> &n)
+{
+  return n.low () & 1;
+}
+
+template<std::size_t Bits>
+bool even (const wide_uint<Bits> &n)
+{
+  return !odd (n);
+}
+
+/* Binary GCD.  */
+
+template<std::size_t Bits>
+wide_uint<Bits> binary_gcd (wide_uint<Bits> a, wide_uint<Bits> b)
+{
+  if (!a)
+    return b;
+  if (!b)
+    return a;
+  std::size_t za = countr_zero (a), zb = countr_zero (b);
+  a >>= za;
+  b >>= zb;
+  while (a != b)
+    {
+      if (a < b)
+	std::swap (a, b);
+      a -= b;
+      a >>= countr_zero (a);
+    }
+  return a << std::min (za, zb);
+}
+
+/* Lehmer's GCD.  Euclid's algorithm on multi-limb numbers spends its
+   time on long divisions, yet the quotients are nearly always tiny and
+   depend only on the leading bits.  So run Euclid on the top 63 bits of
+   A and B alone, tracking the cofactors
+
+     a' = A a + B b,  b' = C a + D b
+
+   for as long as the quotients are certain to be the true ones
+   (Collins' test: both ends of the possible range agree), and then
+   apply all of those steps to A and B at once with four single-limb
+   multiplications.  Each such round retires about a limb's worth of
+   bits.  Once B fits in one limb, finish with 64-bit arithmetic.  */
+
+template<std::size_t Bits>
+wide_uint<Bits> lehmer_gcd (wide_uint<Bits> a, wide_uint<Bits> b)
+{
+  using i128 = __int128;
+  constexpr std::size_t N = wide_uint<Bits>::nlimbs;
+  if (a < b)
+    std::swap (a, b);
+  while (bit_width (b) > 64)
+    {
+      const std::size_t s = bit_width (a) - 63;
+      i128 ah = (a >> s).low (), bh = (b >> s).low ();
+      i128 A = 1, B = 0, C = 0, D = 1;
+      while (bh + C != 0 && bh + D != 0)
+	{
+	  const i128 q = (ah + A) / (bh + C);
+	  if (q != (ah + B) / (bh + D))
+	    break;
+	  i128 t = A - q * C;
+	  A = C;
+	  C = t;
+	  t = B - q * D;
+	  B = D;
+	  D = t;
+	  t = ah - q * bh;
+	  ah = bh;
+	  bh = t;
+	}
+      if (B == 0)
+	{
+	  /* Not even one quotient was certain: do a full step.  */
+	  a %= b;
+	  std::swap (a, b);
+	  continue;
+	}
+      /* X * a + Y * b where X and Y don't have the same sign.  The
+	 result is nonnegative and fits, so the subtraction can wrap
+	 freely.  */
+      auto combine = [&] (i128 x, i128 y) {
+	wide_uint<Bits> u, v;
+	mp_mul_1 (u.limbs.data (), a.limbs.data (), limb (x < 0 ? -x : x), N);
+	mp_mul_1 (v.limbs.data (), b.limbs.data (), limb (y < 0 ? -y : y), N);
+	return x < 0 ? v - u : y < 0 ? u - v : u + v;
+      };
+      wide_uint<Bits> na = combine (A, B);
+      b = combine (C, D);
+      a = na;
+    }
+  if (!b)
+    return a;
+  const limb r = a.mod_1 (b.low ());
+  return std::gcd (b.low (), r);
+}
+
+/* Lehmer only pays off once the numbers span a few limbs.  */
+
+template<std::size_t Bits>
+wide_uint<Bits> gcd (const wide_uint<Bits> &a, const wide_uint<Bits> &b)
+{
+  if constexpr (wide_uint<Bits>::nlimbs > 2)
+    return lehmer_gcd (a, b);
+  else
+    return binary_gcd (a, b);
+}
+
+template<std::size_t Bits>
+bool coprime_p (const wide_uint<Bits> &a, const wide_uint<Bits> &b)
+{
+  return gcd (a, b) == 1;
+}
+
+/* Montgomery arithmetic modulo an odd N of up to Bits bits, with
+   R = 2^Bits.  Like montgomery.h, but the product is formed in full
+   (with Karatsuba once it pays off) and then reduced one limb at a
+   time.  */
+
+template<std::size_t Bits>
+class wide_montgomery {
+public:
+  using number = wide_uint<Bits>;
+  static constexpr std::size_t N = number::nlimbs;
+
+  explicit wide_montgomery (const number &n) : n_(n)
+  {
+    /* -N^-1 mod 2^64.  */
+    limb inv = n.low ();
+    for (int i = 0; i < 5; ++i)
+      inv *= 2 - n.low () * inv;
+    ninv_ = -inv;
+    /* R mod N, then R^2 mod N by doubling it Bits times.  */
+    one_ = (number () - n) % n;
+    r2_ = one_;
+    for (std::size_t i = 0; i < Bits; ++i)
+      {
+	bool carry = r2_.bit (Bits - 1);
+	r2_ <<= 1;
+	if (carry || r2_ >= n_)
+	  r2_ -= n_;
+      }
+  }
+
+  const number &modulus () const { return n_; }
+  const number &one () const { return one_; }
+
+  number to (const number &a) const { return mul (a % n_, r2_); }
+  number from (const number &a) const { return mul (a, number (1)); }
+
+  number mul (const number &a, const number &b) const
+  {
+    using u128 = unsigned __int128;
+    limb t[2 * N + 1];
+    mp_mul<N> (t, a.limbs.data (), b.limbs.data ());
+    t[2 * N] = 0;
+    /* REDC: add multiples of N that clear the low limbs, one limb per
+       step, then drop them.  */
+    for (std::size_t i = 0; i < N; ++i)
+      {
+	limb m = t[i] * ninv_;
+	limb c = 0;
+	for (std::size_t j = 0; j < N; ++j)
+	  {
+	    u128 s = u128 (m) * n_.limbs[j] + t[i + j] + c;
+	    t[i + j] = limb (s);
+	    c = s >> 64;
+	  }
+	mp_add_1 (t + i + N, c, N + 1 - i);
+      }
+    number r;
+    for (std::size_t i = 0; i < N; ++i)
+      r.limbs[i] = t[N + i];
+    if (t[2 * N] || r >= n_)
+      r -= n_;
+    return r;
+  }
+
+  number operator() (const number &a, const number &b) const
+  {
+    return mul (a, b);
+  }
+
+  /* A^E, with A in Montgomery form.  */
+  number pow (const number &a, const number &e) const
+  {
+    number r = one_;
+    for (std::size_t i = bit_width (e); i-- > 0; )
+      {
+	r = mul (r, r);
+	if (e.bit (i))
+	  r = mul (r, a);
+      }
+    return r;
+  }
+
+private:
+  number n_;
+  limb ninv_;
+  number one_;
+  number r2_;
+};
+
+/* A * B mod M, with the product formed in full.  */
+
+template<std::size_t Bits>
+wide_uint<Bits> mul_mod (const wide_uint<Bits> &a, const wide_uint<Bits> &b,
+			 const wide_uint<Bits> &m)
+{
+  wide_uint<2 * Bits> t;
+  mp_mul<wide_uint<Bits>::nlimbs> (t.limbs.data (), a.limbs.data (),
+				   b.limbs.data ());
+  return wide_uint<Bits> (t % wide_uint<2 * Bits> (m));
+}
+
+/* Modular exponentiation: B^E mod M.  */
+
+template<std::size_t Bits>
+wide_uint<Bits> modular_pow (wide_uint<Bits> b, const wide_uint<Bits> &e,
+			     const wide_uint<Bits> &m)
+{
+  if (m == 1)
+    return 0;
+  if (odd (m))
+    {
+      const wide_montgomery<Bits> mont (m);
+      return mont.from (mont.pow (mont.to (b), e));
+    }
+
+  wide_uint<Bits> r = 1;
+  b %= m;
+  for (std::size_t i = bit_width (e); i-- > 0; )
+    {
+      r = mul_mod (r, r, m);
+      if (e.bit (i))
+	r = mul_mod (r, b, m);
+    }
+  return r;
+}
+
+/* The 308 odd primes below 2048, for trial division.  */
+
+inline constexpr auto trial_primes = [] {
+  constexpr std::size_t n = 2048;
+  std::array<bool, n> composite{};
+  std::array<limb, 308> r{};
+  std::size_t k = 0;
+  for (std::size_t i = 3; i < n; i += 2)
+    if (!composite[i])
+      {
+	r[k++] = i;
+	for (std::size_t j = i * i; j < n; j += 2 * i)
+	  composite[j] = true;
+      }
+  return r;
+} ();
+
+static_assert (trial_primes.back () == 2039);
+
+/* A random number of exactly NBITS bits.  */
+
+template<std::size_t Bits>
+wide_uint<Bits> random_wide_uint (std::size_t nbits)
+{
+  wide_uint<Bits> r;
+  for (auto &l : r.limbs)
+    l = witness_rand ();
+  r >>= Bits - nbits;
+  r |= wide_uint<Bits> (1) << (nbits - 1);
+  return r;
+}
+
+/* Return true if N is probably prime, and false if it definitely is not.
+   Trial division by small primes first, then Miller-Rabin with base 2
+   and a few random bases.  */
+
+template<std::size_t Bits>
+bool prime_p (const wide_uint<Bits> &n)
+{
+  using number = wide_uint<Bits>;
+  if (n < 4)
+    return n == 2 || n == 3;
+  if (even (n))
+    return false;
+  for (limb p : trial_primes)
+    if (n.mod_1 (p) == 0)
+      return n == p;
+
+  const number n1 = n - 1;
+  const std::size_t k = countr_zero (n1);
+  const number q = n1 >> k;
+  const wide_montgomery<Bits> mont (n);
+  const number minus_one = n - mont.one ();
+
+  auto witness = [&] (const number &w) {
+    number x = mont.pow (mont.to (w), q);
+    if (x == mont.one () || x == minus_one)
+      return true;
+    for (std::size_t i = 1; i < k; ++i)
+      {
+	x = mont.mul (x, x);
+	if (x == minus_one)
+	  return true;
+	if (x == mont.one ())
+	  return false;
+      }
+    return false;
+  };
+
+  if (!witness (2))
+    return false;
+  for (int i = 0; i < 7; ++i)
+    {
+      /* Random W in [2, n - 2].  */
+      number w = random_wide_uint<Bits> (Bits) % (n - 3) + 2;
+      if (!witness (w))
+	return false;
+    }
+  return true;
+}
+
+#endif // C++20
+
+#endif // _GOO_BIGINT_H
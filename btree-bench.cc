@@ -0,0 +1,259 @@
+// Benchmarks for btree.cc: traversals and the queries built on them, on
+// complete binary trees and on chains, made of node *, in a tree_arena
+// or laid out as an eytzinger_tree; building them from traversals; and
+// searches in binary search trees.
+// See bench.h for how to build and run it.
+// Use -std=c++20 -O2 -pthread.
+
+#include "bench.h"
+#include <streambuf>
+
+/* Take the functions from btree.cc, but not its main.  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main btree_main
+#include "btree.cc"
+#undef main
+#pragma GCC diagnostic pop
+
+/* Swallows whatever the traversals print, so that they can be timed
+   without the terminal.  */
+
+class null_buf : public std::streambuf {
+protected:
+  int_type overflow (int_type c) override { return c; }
+  std::streamsize xsputn (const char *, std::streamsize n) override
+  {
+    return n;
+  }
+};
+
+/* Time everything on the tree of N nodes that PARENT describes (see
+   buildp), named SHAPE, with its nodes from A, named KIND.  Ops are
+   nodes.  */
+
+template<typename A>
+static void
+bench_tree (bench_suite &suite, const std::string &shape,
+	    std::vector<int> &parent, A &a, const char *kind)
+{
+  const int n = parent.size ();
+  auto t = buildp (a, parent.data (), n);
+  auto run = [&] (const char *name, auto f) {
+    suite.run (name + ("/" + shape) + "/" + kind, n, n, f);
+  };
+
+  run ("height", [&] { do_not_optimize (height (t)); });
+  run ("diameter2", [&] {
+    int h = 0;
+    do_not_optimize (diameter2 (t, &h));
+  });
+  run ("balanced_p", [&] { do_not_optimize (balanced_p (t)); });
+  run ("find_max", [&] { do_not_optimize (find_max (t)); });
+  run ("id", [&] { do_not_optimize (id (t, opaque (t))); });
+  run ("mirror", [&] {
+    mirror (t);
+    do_not_optimize (left (t));
+  });
+
+  /* The same folds, forked over all the hardware threads.  */
+  static fork_join pool;
+  run ("parallel/height", [&] { do_not_optimize (height (t, &pool)); });
+  run ("parallel/diameter2", [&] {
+    int h = 0;
+    do_not_optimize (diameter2 (t, &h, &pool));
+  });
+  run ("parallel/balanced_p", [&] {
+    do_not_optimize (balanced_p (t, &pool));
+  });
+  run ("parallel/find_max", [&] { do_not_optimize (find_max (t, &pool)); });
+  run ("parallel/sum_p", [&] { do_not_optimize (sum_p (t, &pool)); });
+
+  auto sum = [&] (auto &&nodes) {
+    long s = 0;
+    for (auto x : nodes)
+      s += value (x);
+    do_not_optimize (s);
+  };
+  run ("sum/preorder_nodes", [&] { sum (preorder_nodes (t)); });
+  run ("sum/inorder_nodes", [&] { sum (inorder_nodes (t)); });
+  run ("sum/postorder_nodes", [&] { sum (postorder_nodes (t)); });
+  run ("sum/levelorder_nodes", [&] { sum (levelorder_nodes (t)); });
+  run ("sum/morris_inorder", [&] {
+    long s = 0;
+    morris_inorder (t, [&] (auto x) { s += value (x); });
+    do_not_optimize (s);
+  });
+  run ("sum/morris_preorder", [&] {
+    long s = 0;
+    morris_preorder (t, [&] (auto x) { s += value (x); });
+    do_not_optimize (s);
+  });
+
+  null_buf nb;
+  std::streambuf *old = std::cout.rdbuf (&nb);
+  run ("inorder", [&] { inorder (t); });
+  run ("preorder", [&] { preorder (t); });
+  run ("postorder", [&] { postorder (t); });
+  std::cout.rdbuf (old);
+}
+
+/* find_max, level and print_levels on the tree PARENT describes, laid
+   out as an eytzinger_tree.  */
+
+static void
+bench_eytzinger (bench_suite &suite, const std::string &shape,
+		 std::vector<int> &parent)
+{
+  const int n = parent.size ();
+  const eytzinger_tree e (parent.data (), n);
+  auto run = [&] (const char *name, auto f) {
+    suite.run (name + ("/" + shape) + "/eytzinger", n, n, f);
+  };
+
+  run ("find_max", [&] { do_not_optimize (find_max (e)); });
+  null_buf nb;
+  std::streambuf *old = std::cout.rdbuf (&nb);
+  run ("level", [&] { level (e, -1); });
+  run ("print_levels", [&] { print_levels (e, 1, 64); });
+  std::cout.rdbuf (old);
+}
+
+/* Look up random keys among N, in a sorted array, in a binary search
+   tree of node *, and in an eytzinger_tree.  The node * tree has the
+   same shape as the eytzinger_tree, and its nodes were allocated level
+   by level.  Ops are lookups.  */
+
+static void
+bench_search (bench_suite &suite, std::size_t n)
+{
+  constexpr std::size_t count = 1000;
+  std::vector<int> sorted (n), keys (count);
+  for (std::size_t i = 0; i < n; ++i)
+    sorted[i] = 2 * i;
+  bench_random rng;
+  for (int &k : keys)
+    k = rng.below (2 * n);
+  const eytzinger_tree e = eytzinger_tree::sorted (sorted.data (), n);
+  std::vector<node *> nodes (n + 1);
+  for (std::size_t k = 1; k <= n; ++k)
+    {
+      nodes[k] = new_node (e.value (k));
+      if (k > 1)
+	(k % 2 ? nodes[k / 2]->right : nodes[k / 2]->left) = nodes[k];
+    }
+
+  auto run = [&] (const char *name, auto f) {
+    suite.run (std::string ("search/") + name, n, count, [&] {
+      long sum = 0;
+      for (int k : keys)
+	sum += f (k);
+      do_not_optimize (sum);
+    });
+  };
+  run ("sorted", [&] (int x) {
+    return *std::lower_bound (sorted.begin (), sorted.end () - 1, x);
+  });
+  run ("pointer", [&] (int x) {
+    node *r = nullptr;
+    for (node *t = nodes[1]; t; )
+      if (t->val < x)
+	t = t->right;
+      else
+	{
+	  r = t;
+	  t = t->left;
+	}
+    return r ? r->val : 0;
+  });
+  run ("eytzinger", [&] (int x) {
+    std::size_t k = e.lower_bound (x);
+    return k ? e.value (k) : 0;
+  });
+}
+
+/* Rebuild the tree that PARENT describes from its traversals, into an
+   arena that is cleared each time.  Ops are nodes.  */
+
+static void
+bench_build (bench_suite &suite, const std::string &shape,
+	     std::vector<int> &parent)
+{
+  const int n = parent.size ();
+  tree_arena a (n);
+  tref t = buildp (a, parent.data (), n);
+  std::vector<int> in, pre, post;
+  for (tref c : inorder_nodes (t))
+    in.push_back (value (c));
+  for (tref c : preorder_nodes (t))
+    pre.push_back (value (c));
+  for (tref c : postorder_nodes (t))
+    post.push_back (value (c));
+
+  auto run = [&] (const char *name, auto f) {
+    suite.run (name + ("/" + shape), n, n, [&] {
+      a.clear ();
+      do_not_optimize (f ());
+    });
+  };
+  run ("buildp", [&] { return buildp (a, parent.data (), n); });
+  run ("buildpost", [&] {
+    return buildpost (a, in.data (), post.data (), n);
+  });
+  run ("buildpre", [&] { return buildpre (a, in.data (), pre.data (), n); });
+}
+
+int
+main (int argc, char **argv)
+{
+  bench_suite suite ("btree", argc, argv);
+
+  for (std::uint64_t n : sweep (1024, 1 << 20, 4))
+    {
+      std::vector<int> parent (n);
+      for (std::size_t i = 0; i < n; ++i)
+	parent[i] = (int (i) - 1) >> 1;
+      node_heap h;
+      tree_arena a (n);
+      bench_tree (suite, "complete", parent, h, "pointer");
+      bench_tree (suite, "complete", parent, a, "arena");
+      bench_eytzinger (suite, "complete", parent);
+      bench_build (suite, "complete", parent);
+    }
+
+  /* The same, with the nodes allocated in random order, as they end up
+     after a while of inserting and deleting.  */
+  bench_random rng;
+  for (std::uint64_t n : sweep (1024, 1 << 20, 4))
+    {
+      std::vector<int> label (n), parent (n);
+      for (std::size_t i = 0; i < n; ++i)
+	label[i] = i;
+      for (std::size_t i = n - 1; i > 0; --i)
+	std::swap (label[i], label[rng.below (i + 1)]);
+      parent[label[0]] = -1;
+      for (std::size_t i = 1; i < n; ++i)
+	parent[label[i]] = label[(i - 1) / 2];
+      node_heap h;
+      tree_arena a (n);
+      bench_tree (suite, "shuffled", parent, h, "pointer");
+      bench_tree (suite, "shuffled", parent, a, "arena");
+    }
+
+  /* Every node has just a left child: recursion as deep as the tree is
+     big.  */
+  for (std::uint64_t n : sweep (1024, 16384, 4))
+    {
+      std::vector<int> parent (n);
+      for (std::size_t i = 0; i < n; ++i)
+	parent[i] = int (i) - 1;
+      node_heap h;
+      tree_arena a (n);
+      bench_tree (suite, "chain", parent, h, "pointer");
+      bench_tree (suite, "chain", parent, a, "arena");
+      bench_build (suite, "chain", parent);
+    }
+
+  for (std::uint64_t n : sweep (1024, 1 << 22, 16))
+    bench_search (suite, n);
+}
@@ -1,7 +1,27 @@
+// Binary trees.
+// Use -std=c++20 -pthread.
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ranges>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <deque>
 #include <climits>
+#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 struct node
 {
@@ -19,64 +39,813 @@ new_node (int i)
   return n;
 }
 
-static void
-inorder_1 (node *root)
+/* Nodes can also live in a tree_arena: one contiguous array of 12-byte
+   slots that point to their children by 32-bit index, instead of 24-byte
+   nodes that each come from their own new.  Index 0 is never a node; it
+   stands for the empty tree, so that a zeroed slot is a leaf.  All the
+   nodes go at once with clear or with the arena; release puts a single
+   node on a free list that new_node takes from first.  An arena holds
+   at most 2^32 - 1 nodes; new_node throws std::length_error beyond.  */
+
+class tree_arena
 {
-  if (root == nullptr)
-    return;
-  inorder_1 (root->left);
-  std::cout << root->val << " ";
-  inorder_1 (root->right);
+public:
+  struct slot
+  {
+    int val;
+    std::uint32_t left;
+    std::uint32_t right;
+  };
+
+  /* A node of the arena, or the empty tree.  */
+  struct ref
+  {
+    tree_arena *a;
+    std::uint32_t i;
+
+    explicit operator bool () const { return i != 0; }
+    bool operator== (ref o) const { return i == o.i; }
+    bool operator!= (ref o) const { return i != o.i; }
+    slot &operator* () const { return a->nodes_[i]; }
+    slot *operator-> () const { return &a->nodes_[i]; }
+  };
+
+  tree_arena () : nodes_ (1) {}
+
+  /* Room for N nodes before the array has to grow.  */
+  explicit tree_arena (std::size_t n) : tree_arena () { reserve (n); }
+
+  /* Every ref points to its arena, so an arena stays where it is.  */
+  tree_arena (const tree_arena &) = delete;
+  tree_arena (tree_arena &&) = delete;
+  tree_arena &operator= (const tree_arena &) = delete;
+  tree_arena &operator= (tree_arena &&) = delete;
+
+  /* Room for N more nodes, in one step.  Growing still at least
+     doubles the array, so that many small reserves stay cheap.  */
+  void reserve (std::size_t n)
+  {
+    if (nodes_.capacity () - nodes_.size () < n)
+      nodes_.reserve (std::max (nodes_.size () + n,
+				2 * nodes_.capacity ()));
+  }
+
+  ref null () { return { this, 0 }; }
+
+  ref new_node (int i)
+  {
+    std::uint32_t k = free_;
+    if (k != 0)
+      free_ = nodes_[k].left;
+    else
+      {
+	/* Past that, the index would wrap around to 0, the empty tree.  */
+	if (nodes_.size () > UINT32_MAX)
+	  throw std::length_error ("tree_arena: more than 2^32 - 1 nodes");
+	k = nodes_.size ();
+	nodes_.emplace_back ();
+      }
+    nodes_[k] = { i, 0, 0 };
+    return { this, k };
+  }
+
+  /* Give N back, but not its children.  */
+  void release (ref n)
+  {
+    nodes_[n.i].left = free_;
+    free_ = n.i;
+  }
+
+  /* Free all the nodes.  */
+  void clear ()
+  {
+    nodes_.resize (1);
+    free_ = 0;
+  }
+
+  /* Slots in use or on the free list.  */
+  std::size_t capacity () const { return nodes_.size () - 1; }
+
+private:
+  std::vector<slot> nodes_;
+  /* Head of the free list, chained through left.  */
+  std::uint32_t free_ = 0;
+};
+
+static_assert (sizeof (tree_arena::slot) == 12, "slots must be 12 bytes");
+static_assert (!std::is_copy_constructible_v<tree_arena>
+	       && !std::is_move_assignable_v<tree_arena>);
+
+/* new for the node * trees, like tree_arena for the others.  */
+
+struct node_heap
+{
+  node *null () { return nullptr; }
+  node *new_node (int i) { return ::new_node (i); }
+  /* Each node is a new of its own: nothing to reserve.  */
+  void reserve (std::size_t) {}
+};
+
+/* The algorithms below get at the nodes only through these, so they work
+   on either kind of tree: !T says T is empty, and
+
+     left (T), right (T)          are the children,
+     value (T)                    is a reference to the value,
+     set_left (T, C), set_right   change the children,
+     null_node (T)                is an empty tree of the same kind, and
+     make_node (T, V)             allocates a node the way T was.  */
+
+inline node *left (node *t) { return t->left; }
+inline node *right (node *t) { return t->right; }
+inline int &value (node *t) { return t->val; }
+inline void set_left (node *t, node *c) { t->left = c; }
+inline void set_right (node *t, node *c) { t->right = c; }
+inline node *null_node (node *) { return nullptr; }
+inline node *make_node (node *, int v) { return new_node (v); }
+
+using tref = tree_arena::ref;
+
+inline tref left (tref t) { return { t.a, t->left }; }
+inline tref right (tref t) { return { t.a, t->right }; }
+inline int &value (tref t) { return t->val; }
+inline void set_left (tref t, tref c) { t->left = c.i; }
+inline void set_right (tref t, tref c) { t->right = c.i; }
+inline tref null_node (tref t) { return { t.a, 0 }; }
+inline tref make_node (tref t, int v) { return t.a->new_node (v); }
+
+/* Lazy traversals.  Each of these iterators walks a tree in some order,
+   keeping its own stack (a queue, for level order) instead of recursing,
+   so any depth of tree is fine, and the caller can stop whenever it
+   likes.  *IT is the node, so value (*IT) is its value.  They are
+   forward iterators, and end at std::default_sentinel.  */
+
+template<typename N>
+class preorder_iterator
+{
+public:
+  using value_type = N;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  preorder_iterator () = default;
+  explicit preorder_iterator (N t)
+  {
+    if (t)
+      stk_.push_back (t);
+  }
+
+  N operator* () const { return stk_.back (); }
+
+  preorder_iterator &operator++ ()
+  {
+    N n = stk_.back ();
+    stk_.pop_back ();
+    if (right (n))
+      stk_.push_back (right (n));
+    if (left (n))
+      stk_.push_back (left (n));
+    return *this;
+  }
+
+  preorder_iterator operator++ (int)
+  {
+    preorder_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  bool operator== (std::default_sentinel_t) const { return stk_.empty (); }
+  bool operator== (const preorder_iterator &o) const
+  {
+    return stk_.empty () ? o.stk_.empty ()
+			 : !o.stk_.empty () && **this == *o;
+  }
+
+private:
+  std::vector<N> stk_;
+};
+
+/* The stack holds the nodes whose left subtree is being walked: the
+   path down from the root, less the nodes already passed on the right.  */
+
+template<typename N>
+class inorder_iterator
+{
+public:
+  using value_type = N;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  inorder_iterator () = default;
+  explicit inorder_iterator (N t) { descend (t); }
+
+  N operator* () const { return stk_.back (); }
+
+  inorder_iterator &operator++ ()
+  {
+    N n = stk_.back ();
+    stk_.pop_back ();
+    descend (right (n));
+    return *this;
+  }
+
+  inorder_iterator operator++ (int)
+  {
+    inorder_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  bool operator== (std::default_sentinel_t) const { return stk_.empty (); }
+  bool operator== (const inorder_iterator &o) const
+  {
+    return stk_.empty () ? o.stk_.empty ()
+			 : !o.stk_.empty () && **this == *o;
+  }
+
+private:
+  void descend (N t)
+  {
+    for (; t; t = left (t))
+      stk_.push_back (t);
+  }
+
+  std::vector<N> stk_;
+};
+
+/* The stack is the path from the root down to the current node.  After
+   a node comes its parent, unless the node was the left child and there
+   is a right one: then the first leaf down that side.  */
+
+template<typename N>
+class postorder_iterator
+{
+public:
+  using value_type = N;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  postorder_iterator () = default;
+  explicit postorder_iterator (N t) { descend (t); }
+
+  N operator* () const { return stk_.back (); }
+
+  postorder_iterator &operator++ ()
+  {
+    N n = stk_.back ();
+    stk_.pop_back ();
+    if (!stk_.empty ())
+      {
+	N p = stk_.back ();
+	if (left (p) == n && right (p))
+	  descend (right (p));
+      }
+    return *this;
+  }
+
+  postorder_iterator operator++ (int)
+  {
+    postorder_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  bool operator== (std::default_sentinel_t) const { return stk_.empty (); }
+  bool operator== (const postorder_iterator &o) const
+  {
+    return stk_.empty () ? o.stk_.empty ()
+			 : !o.stk_.empty () && **this == *o;
+  }
+
+private:
+  void descend (N t)
+  {
+    while (t)
+      {
+	stk_.push_back (t);
+	t = left (t) ? left (t) : right (t);
+      }
+  }
+
+  std::vector<N> stk_;
+};
+
+template<typename N>
+class levelorder_iterator
+{
+public:
+  using value_type = N;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  levelorder_iterator () = default;
+  explicit levelorder_iterator (N t)
+  {
+    if (t)
+      q_.push_back (t);
+  }
+
+  N operator* () const { return q_.front (); }
+
+  levelorder_iterator &operator++ ()
+  {
+    N n = q_.front ();
+    q_.pop_front ();
+    if (left (n))
+      q_.push_back (left (n));
+    if (right (n))
+      q_.push_back (right (n));
+    return *this;
+  }
+
+  levelorder_iterator operator++ (int)
+  {
+    levelorder_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  bool operator== (std::default_sentinel_t) const { return q_.empty (); }
+  bool operator== (const levelorder_iterator &o) const
+  {
+    return q_.empty () ? o.q_.empty () : !o.q_.empty () && **this == *o;
+  }
+
+private:
+  std::deque<N> q_;
+};
+
+/* A traversal as a range, for range-based for and <ranges>.  */
+
+template<typename It>
+struct traversal : std::ranges::view_interface<traversal<It>>
+{
+  It first;
+
+  traversal () = default;
+  explicit traversal (It it) : first (std::move (it)) {}
+  It begin () const { return first; }
+  std::default_sentinel_t end () const { return {}; }
+};
+
+/* The iterators hold all their state, so they outlive the range.  */
+template<typename It>
+inline constexpr bool std::ranges::enable_borrowed_range<traversal<It>>
+  = true;
+
+template<typename N>
+static traversal<preorder_iterator<N>>
+preorder_nodes (N t)
+{
+  return traversal (preorder_iterator (t));
+}
+
+template<typename N>
+static traversal<inorder_iterator<N>>
+inorder_nodes (N t)
+{
+  return traversal (inorder_iterator (t));
+}
+
+template<typename N>
+static traversal<postorder_iterator<N>>
+postorder_nodes (N t)
+{
+  return traversal (postorder_iterator (t));
+}
+
+template<typename N>
+static traversal<levelorder_iterator<N>>
+levelorder_nodes (N t)
+{
+  return traversal (levelorder_iterator (t));
+}
+
+static_assert (std::forward_iterator<inorder_iterator<node *>>);
+static_assert (std::ranges::forward_range<traversal<postorder_iterator<tref>>>);
+
+/* Call F (N) on node N.  F can return false to say that it wants no
+   more nodes; a void F always wants more.  */
+
+template<typename N, typename F>
+static bool
+visit (F &f, N n)
+{
+  if constexpr (std::is_void_v<decltype (f (n))>)
+    {
+      f (n);
+      return true;
+    }
+  else
+    return f (n);
 }
 
+/* Morris traversal: in order, in O(1) space.  On the way down the left
+   side, the rightmost node of each left subtree gets a "thread": its
+   empty right link is pointed back at the node above, to climb back up
+   by once that subtree is done.  The second time through, the thread is
+   found again and removed.  So the tree changes while this runs, but is
+   back as it was when it returns, and nothing else may look at it in
+   between.
+
+   Calls F on each node in turn (see visit).  If F stops, the walk goes
+   on without it until the last thread is gone.  */
+
+template<typename N, typename F>
 static void
-inorder (node *root)
+morris_inorder (N t, F f)
 {
-  inorder_1 (root);
-  std::cout << "\n";
+  bool more = true;
+  std::size_t threads = 0;
+  for (N cur = t; cur && (more || threads != 0); )
+    if (!left (cur))
+      {
+	more = more && visit (f, cur);
+	cur = right (cur);
+      }
+    else
+      {
+	N pre = left (cur);
+	while (right (pre) && right (pre) != cur)
+	  pre = right (pre);
+	if (!right (pre))
+	  {
+	    set_right (pre, cur);
+	    ++threads;
+	    cur = left (cur);
+	  }
+	else
+	  {
+	    set_right (pre, null_node (cur));
+	    --threads;
+	    more = more && visit (f, cur);
+	    cur = right (cur);
+	  }
+      }
 }
 
+/* Likewise in preorder: a node is visited on the way down, when its
+   thread is put in.  */
+
+template<typename N, typename F>
 static void
-postorder_1 (node *root)
+morris_preorder (N t, F f)
 {
-  if (root == nullptr)
-    return;
-  postorder_1 (root->left);
-  postorder_1 (root->right);
-  std::cout << root->val << " ";
+  bool more = true;
+  std::size_t threads = 0;
+  for (N cur = t; cur && (more || threads != 0); )
+    if (!left (cur))
+      {
+	more = more && visit (f, cur);
+	cur = right (cur);
+      }
+    else
+      {
+	N pre = left (cur);
+	while (right (pre) && right (pre) != cur)
+	  pre = right (pre);
+	if (!right (pre))
+	  {
+	    more = more && visit (f, cur);
+	    set_right (pre, cur);
+	    ++threads;
+	    cur = left (cur);
+	  }
+	else
+	  {
+	    set_right (pre, null_node (cur));
+	    --threads;
+	    cur = right (cur);
+	  }
+      }
+}
+
+/* A pool of threads for fork-join parallelism, with work stealing.
+   both (F, G) calls F () and G (), perhaps at the same time, and returns
+   when both are done; they can call both in turn.  Each thread keeps
+   the G's it has forked on a deque of its own and takes them back from
+   the newest end, while a thread with nothing to do steals from the
+   oldest end of another's, where the biggest pieces of work are.  A
+   thread whose G was stolen steals in turn while it waits.
+
+   The deques are locked rather than lock-free: callers fork only near
+   the top of their recursion, so there are a few thousand forks a run
+   at most.  A thread from outside the pool becomes its thread 0 for the
+   duration of both; such threads enter one at a time.  The pool's own
+   threads sleep between those calls.  */
+
+class fork_join
+{
+public:
+  explicit fork_join (unsigned threads
+		      = std::max (1u, std::thread::hardware_concurrency ()))
+    : workers_ (std::max (threads, 1u))
+  {
+    for (unsigned i = 1; i < workers_.size (); ++i)
+      pool_.emplace_back ([this, i] { serve (i); });
+  }
+
+  ~fork_join ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (wake_);
+      stop_ = true;
+    }
+    woken_.notify_all ();
+    for (auto &th : pool_)
+      th.join ();
+  }
+
+  fork_join (const fork_join &) = delete;
+  fork_join &operator= (const fork_join &) = delete;
+
+  unsigned threads () const { return workers_.size (); }
+
+  /* How many levels of a balanced recursion to fork at: enough for
+     about 16 tasks a thread, or none with one thread.  */
+  int depth () const
+  {
+    return threads () == 1 ? 0 : std::bit_width (threads ()) + 4;
+  }
+
+  template<typename F, typename G>
+  void both (F &&f, G &&g)
+  {
+    if (self_.pool != this)
+      {
+	enter ([&] { both (f, g); });
+	return;
+      }
+    worker &w = workers_[self_.id];
+    task t (g);
+    {
+      std::lock_guard<std::mutex> lock (w.m);
+      w.q.push_back (&t);
+    }
+    f ();
+    /* The forks made by F are joined by now, so T is the newest on the
+       deque, unless it was stolen.  */
+    bool mine;
+    {
+      std::lock_guard<std::mutex> lock (w.m);
+      mine = !w.q.empty () && w.q.back () == &t;
+      if (mine)
+	w.q.pop_back ();
+    }
+    if (mine)
+      g ();
+    else
+      while (!t.done.load (std::memory_order_acquire))
+	if (!steal (self_.id))
+	  std::this_thread::yield ();
+  }
+
+private:
+  struct task
+  {
+    template<typename G>
+    explicit task (G &g)
+      : call ([] (void *p) { (*static_cast<G *> (p)) (); }),
+	arg ((void *) std::addressof (g))
+    {}
+
+    void (*call) (void *);
+    void *arg;
+    std::atomic<bool> done = false;
+  };
+
+  struct alignas (64) worker
+  {
+    std::mutex m;
+    std::deque<task *> q;
+  };
+
+  /* Which pool the current thread works for, if any, and as which
+     thread.  */
+  struct where
+  {
+    fork_join *pool;
+    unsigned id;
+  };
+
+  /* Run the oldest task of another thread than ID, if there is one.  */
+  bool steal (unsigned id)
+  {
+    const unsigned n = threads ();
+    task *t = nullptr;
+    for (unsigned k = 1; !t && k < n; ++k)
+      {
+	worker &v = workers_[(id + k) % n];
+	std::lock_guard<std::mutex> lock (v.m);
+	if (!v.q.empty ())
+	  {
+	    t = v.q.front ();
+	    v.q.pop_front ();
+	  }
+      }
+    if (!t)
+      return false;
+    t->call (t->arg);
+    t->done.store (true, std::memory_order_release);
+    return true;
+  }
+
+  /* Call F () as thread 0, with the pool awake.  */
+  template<typename F>
+  void enter (F f)
+  {
+    std::lock_guard<std::mutex> in (enter_);
+    {
+      std::lock_guard<std::mutex> lock (wake_);
+      busy_ = true;
+    }
+    woken_.notify_all ();
+    const where outer = self_;
+    self_ = { this, 0 };
+    f ();
+    self_ = outer;
+    std::lock_guard<std::mutex> lock (wake_);
+    busy_ = false;
+  }
+
+  /* The loop of thread ID, for as long as the pool lives.  */
+  void serve (unsigned id)
+  {
+    self_ = { this, id };
+    std::unique_lock<std::mutex> lock (wake_);
+    for (;;)
+      {
+	woken_.wait (lock, [this] { return stop_ || busy_; });
+	if (stop_)
+	  return;
+	lock.unlock ();
+	while (busy_.load (std::memory_order_relaxed))
+	  if (!steal (id))
+	    std::this_thread::yield ();
+	lock.lock ();
+      }
+  }
+
+  std::vector<worker> workers_;
+  std::vector<std::thread> pool_;
+  std::mutex enter_;
+  std::mutex wake_;
+  std::condition_variable woken_;
+  std::atomic<bool> busy_ = false;
+  bool stop_ = false;
+  static inline thread_local where self_;
+};
+
+template<typename N, typename T, typename F>
+static T fork_fold (fork_join &pool, N t, T empty, F &f, int depth);
+
+/* Combine bottom up, without recursion: F (N, L, R) gets the results L
+   and R for the subtrees of N, EMPTY for missing ones.  Returns the
+   result for T.  Each frame of the stack is a node on the path from the
+   root, with the result of its left subtree once that's done.
+
+   With a POOL, the top levels of the tree are folded in parallel, and
+   the subtrees below them as above.  F then has to be safe to call from
+   several threads at once, on different nodes.  */
+
+template<typename N, typename T, typename F>
+static T
+fold (N t, T empty, F f, fork_join *pool = nullptr)
+{
+  if (pool && pool->threads () > 1)
+    return fork_fold (*pool, t, empty, f, pool->depth ());
+  struct frame
+  {
+    N n;
+    T l;
+    bool right_side;
+  };
+  std::vector<frame> stk;
+  /* Filling the frames in place is twice as fast as pushing braced
+     ones, which GCC builds on the side and then copies.  */
+  auto descend = [&] (N c) {
+    for (; c; c = left (c))
+      {
+	frame &fr = stk.emplace_back ();
+	fr.n = c;
+	fr.right_side = false;
+      }
+  };
+  T r = empty;
+  descend (t);
+  while (!stk.empty ())
+    {
+      frame &fr = stk.back ();
+      if (!fr.right_side)
+	{
+	  /* R is the result on the left.  */
+	  fr.l = r;
+	  fr.right_side = true;
+	  r = empty;
+	  if (N c = right (fr.n))
+	    {
+	      descend (c);
+	      continue;
+	    }
+	}
+      r = f (fr.n, fr.l, r);
+      stk.pop_back ();
+    }
+  return r;
+}
+
+/* Fold T with F, forking at the top DEPTH levels.  */
+
+template<typename N, typename T, typename F>
+static T
+fork_fold (fork_join &pool, N t, T empty, F &f, int depth)
+{
+  if (!t || depth == 0)
+    return fold (t, empty, f);
+  T l = empty, r = empty;
+  pool.both ([&] { l = fork_fold (pool, left (t), empty, f, depth - 1); },
+	     [&] { r = fork_fold (pool, right (t), empty, f, depth - 1); });
+  return f (t, l, r);
 }
 
+/* What a walk_paths callback wants next.  */
+
+enum class walk { on, skip, stop };
+
+/* Walk T in preorder, without recursion, calling F (PATH) at each node:
+   PATH holds the nodes from the root down to it, so PATH.back () is the
+   node and PATH.size () its depth.  F returns walk::on to go on,
+   walk::skip to leave out the subtrees of the node, or walk::stop to end
+   the walk there.  Returns false if F stopped it.  */
+
+template<typename N, typename F>
+static bool
+walk_paths (N t, F f)
+{
+  std::vector<std::pair<N, std::size_t>> stk;
+  std::vector<N> path;
+  if (t)
+    stk.emplace_back (t, 0);
+  while (!stk.empty ())
+    {
+      auto [n, d] = stk.back ();
+      stk.pop_back ();
+      path.resize (d);
+      path.push_back (n);
+      walk w = f (std::as_const (path));
+      if (w == walk::stop)
+	return false;
+      if (w == walk::skip)
+	continue;
+      if (right (n))
+	stk.emplace_back (right (n), d + 1);
+      if (left (n))
+	stk.emplace_back (left (n), d + 1);
+    }
+  return true;
+}
+
+template<typename N>
 static void
-postorder (node *root)
+inorder (N root)
 {
-  postorder_1 (root);
+  for (N n : inorder_nodes (root))
+    std::cout << value (n) << " ";
   std::cout << "\n";
 }
 
+template<typename N>
 static void
-preorder_1 (node *root)
+postorder (N root)
 {
-  if (root == nullptr)
-    return;
-  std::cout << root->val << " ";
-  preorder_1 (root->left);
-  preorder_1 (root->right);
+  for (N n : postorder_nodes (root))
+    std::cout << value (n) << " ";
+  std::cout << "\n";
 }
 
+template<typename N>
 static void
-preorder (node *root)
+preorder (N root)
 {
-  preorder_1 (root);
+  for (N n : preorder_nodes (root))
+    std::cout << value (n) << " ";
   std::cout << "\n";
 }
 
-static node *
-buildp (int parent[], int n)
+/* Build the tree where node I's parent is PARENT[I] (-1 for the root),
+   with the nodes from A: a tree_arena, or node_heap.  */
+
+template<typename A>
+static auto
+buildp (A &a, int parent[], int n) -> decltype (a.null ())
 {
-  std::vector<node *> v(n);
-  node *root = nullptr;
+  using N = decltype (a.null ());
+  std::vector<N> v;
+  v.reserve (n);
+  a.reserve (n);
+  N root = a.null ();
   for (int i = 0; i < n; i++)
-    v[i] = new_node (i);
+    v.push_back (a.new_node (i));
 
   for (int i = 0; i < n; i++)
     {
@@ -84,368 +853,421 @@ buildp (int parent[], int n)
 	root = v[i];
       else
 	{
-	  if (v[parent[i]]->left == nullptr)
-	    v[parent[i]]->left = v[i];
+	  if (!left (v[parent[i]]))
+	    set_left (v[parent[i]], v[i]);
 	  else
-	    v[parent[i]]->right = v[i];
+	    set_right (v[parent[i]], v[i]);
 	}
     }
 
   return root;
 }
 
-static int
-find_root (int a[], int root, int n)
+static node *
+buildp (int parent[], int n)
 {
-  for (int i = 0; i < n; i++)
-    if (a[i] == root)
-      return i;
-  return -1;
+  node_heap h;
+  return buildp (h, parent, n);
+}
+
+/* Build the tree whose inorder is IN and postorder POST, N values with
+   no two alike, with the nodes from A, in O(N) time and no recursion.
+
+   Backwards, POST is the root, the right subtree, then the left one,
+   and IN the right subtree, the root, then the left one.  STK holds the
+   nodes on the path down from the root to the last one made whose left
+   subtree hasn't been started; IN[J] is the next of those to finish on
+   the right, in that order.  While the top of STK isn't IN[J], each new
+   node is the right child of the last one.  When it is, the top's right
+   subtree is all made: pop the nodes that are finished like that, and
+   the new node goes on the left of the last one popped.  */
+
+template<typename A>
+static auto
+buildpost (A &a, int in[], int post[], int n) -> decltype (a.null ())
+{
+  using N = decltype (a.null ());
+  if (n == 0)
+    return a.null ();
+  a.reserve (n);
+  std::vector<N> stk;
+  N root = a.new_node (post[n - 1]);
+  stk.push_back (root);
+  for (int i = n - 2, j = n - 1; i >= 0; --i)
+    {
+      N c = a.new_node (post[i]);
+      if (value (stk.back ()) != in[j])
+	set_right (stk.back (), c);
+      else
+	{
+	  N p;
+	  do
+	    {
+	      p = stk.back ();
+	      stk.pop_back ();
+	      --j;
+	    }
+	  while (!stk.empty () && value (stk.back ()) == in[j]);
+	  set_left (p, c);
+	}
+      stk.push_back (c);
+    }
+  return root;
 }
 
 static node *
 buildpost (int in[], int post[], int n)
 {
-  node *root = new_node (post[n - 1]);
-  int m = find_root (in, post[n - 1], n);
-  if (m > 0)
-    root->left = buildpost (in, post, m);
-  if (m < n - 1)
-    root->right = buildpost (in + m + 1, post + m, n - m - 1);
+  node_heap h;
+  return buildpost (h, in, post, n);
+}
+
+/* Likewise from the inorder IN and the preorder PRE, forwards, with the
+   sides the other way round.  */
+
+template<typename A>
+static auto
+buildpre (A &a, int in[], int pre[], int n) -> decltype (a.null ())
+{
+  using N = decltype (a.null ());
+  if (n == 0)
+    return a.null ();
+  a.reserve (n);
+  std::vector<N> stk;
+  N root = a.new_node (pre[0]);
+  stk.push_back (root);
+  for (int i = 1, j = 0; i < n; ++i)
+    {
+      N c = a.new_node (pre[i]);
+      if (value (stk.back ()) != in[j])
+	set_left (stk.back (), c);
+      else
+	{
+	  N p;
+	  do
+	    {
+	      p = stk.back ();
+	      stk.pop_back ();
+	      ++j;
+	    }
+	  while (!stk.empty () && value (stk.back ()) == in[j]);
+	  set_right (p, c);
+	}
+      stk.push_back (c);
+    }
   return root;
 }
 
-static int
-left_sum (node *root)
+static node *
+buildpre (int in[], int pre[], int n)
 {
-  if (!root)
-    return 0;
-  int lsum = left_sum (root->left);
-  int rsum = left_sum (root->right);
-  root->val += lsum;
-  return root->val + rsum;
+  node_heap h;
+  return buildpre (h, in, pre, n);
 }
 
-static void
-mirror (node *root)
+template<typename N>
+static int
+left_sum (N root, fork_join *pool = nullptr)
 {
-  if (!root)
-    return;
-  node *tmp = root->left;
-  root->left = root->right;
-  root->right = tmp;
-  mirror (root->left);
-  mirror (root->right);
+  return fold (root, 0, [] (N n, int lsum, int rsum) {
+    value (n) += lsum;
+    return value (n) + rsum;
+  }, pool);
 }
 
-static bool
-id (node *a, node *b)
+template<typename N>
+static void
+mirror (N root)
 {
-  if (!a && !b)
-    return true;
-  if (!a || !b)
-    return false;
-  return (a->val == b->val
-	  && id (a->left, b->left)
-	  && id (a->right, b->right));
+  for (N n : preorder_nodes (root))
+    {
+      N tmp = left (n);
+      set_left (n, right (n));
+      set_right (n, tmp);
+    }
 }
 
+/* Walk both trees in preorder, side by side.  */
+
+template<typename N>
 static bool
-has_sum_1 (node *t, int k, int sum)
+id (N a, N b)
 {
-  if (!t)
-    return false;
-  sum += t->val;
-  if (!t->left && !t->right && sum == k)
-    return true;
-  return has_sum_1 (t->left, k, sum) || has_sum_1 (t->right, k, sum);
+  std::vector<std::pair<N, N>> stk = { { a, b } };
+  while (!stk.empty ())
+    {
+      auto [x, y] = stk.back ();
+      stk.pop_back ();
+      if (!x && !y)
+	continue;
+      if (!x || !y || value (x) != value (y))
+	return false;
+      stk.push_back ({ right (x), right (y) });
+      stk.push_back ({ left (x), left (y) });
+    }
+  return true;
 }
 
+template<typename N>
 static bool
-has_sum (node *t, int sum)
+has_sum (N t, int sum)
 {
-  return has_sum_1 (t, sum, 0);
+  /* SUMS[I] is the sum down to the node at depth I + 1.  */
+  std::vector<int> sums;
+  return !walk_paths (t, [&] (const std::vector<N> &path) {
+    N n = path.back ();
+    sums.resize (path.size () - 1);
+    sums.push_back ((sums.empty () ? 0 : sums.back ()) + value (n));
+    if (!left (n) && !right (n) && sums.back () == sum)
+      return walk::stop;
+    return walk::on;
+  });
 }
 
+template<typename N>
 static int
-check_height (node *t)
+check_height (N t, fork_join *pool = nullptr)
 {
-  if (!t)
-    return 0;
-  int l = check_height (t->left);
-  if (l == -1)
-    return -1;
-  int r = check_height (t->right);
-  if (r == -1)
-    return -1;
-  if (std::abs (l - r) > 1)
-    return -1;
-  return std::max (l, r) + 1;
+  return fold (t, 0, [] (N, int l, int r) {
+    if (l == -1 || r == -1 || std::abs (l - r) > 1)
+      return -1;
+    return std::max (l, r) + 1;
+  }, pool);
 }
 
+template<typename N>
 static bool
-balanced_p (node *t)
+balanced_p (N t, fork_join *pool = nullptr)
 {
-  return check_height (t) != -1;
+  return check_height (t, pool) != -1;
 }
 
+template<typename N>
 static int
-height (node *t)
+height (N t, fork_join *pool = nullptr)
 {
-  if (!t)
-    return 0;
-  return std::max (height (t->left), height (t->right)) + 1;
+  return fold (t, 0, [] (N, int l, int r) {
+    return std::max (l, r) + 1;
+  }, pool);
 }
 
+template<typename N>
 static int
-diameter (node *t)
+diameter (N t)
 {
-  if (t == nullptr)
-    return 0;
-  int diam = 1 + height (t->left) + height (t->right);
-  return std::max (diam, std::max (diameter (t->left), diameter (t->right)));
+  int diam = 0;
+  for (N n : preorder_nodes (t))
+    diam = std::max (diam, 1 + height (left (n)) + height (right (n)));
+  return diam;
 }
 
+template<typename N>
 static int
-diameter2 (node *t, int *height)
+diameter2 (N t, int *height, fork_join *pool = nullptr)
 {
-  if (!t)
-    return 0;
-  int lh = 0, rh = 0;
-  int ldiam = diameter2 (t->left, &lh);
-  int rdiam = diameter2 (t->right, &rh);
-  *height = std::max (lh, rh) + 1;
-  return std::max (lh + rh + 1, std::max (ldiam, rdiam));
+  /* Height and diameter of each subtree.  */
+  using hd = std::pair<int, int>;
+  auto [h, d] = fold (t, hd (0, 0), [] (N, hd l, hd r) {
+    return hd (std::max (l.first, r.first) + 1,
+	       std::max (l.first + r.first + 1,
+			 std::max (l.second, r.second)));
+  }, pool);
+  if (t)
+    *height = h;
+  return d;
 }
 
+template<typename N>
 static bool
-sum_p (node *t)
+sum_p (N t, fork_join *pool = nullptr)
 {
-  if (!t || (!t->left && !t->right))
-    return true;
-  int l = t->left ? t->left->val : 0;
-  int r = t->right ? t->right->val : 0;
-  if (t->val != (l + r))
-    return false;
-  return sum_p (t->left) && sum_p (t->right);
+  /* Whether N is a leaf or the sum of its children.  */
+  auto ok = [] (N n) {
+    if (!left (n) && !right (n))
+      return true;
+    int l = left (n) ? value (left (n)) : 0;
+    int r = right (n) ? value (right (n)) : 0;
+    return value (n) == l + r;
+  };
+  if (pool)
+    return fold (t, true, [&] (N n, bool l, bool r) {
+      return l && r && ok (n);
+    }, pool);
+  return std::ranges::all_of (preorder_nodes (t), ok);
 }
 
+template<typename N>
 static bool
-is_leaf (node *t)
+is_leaf (N t)
 {
-  return t && !t->left && !t->right;
+  return t && !left (t) && !right (t);
 }
 
+template<typename N>
 static bool
-sum_tree_p (node *t)
+sum_tree_p (N t)
 {
-  if (!t || (!t->left && !t->right))
-    return true;
-  int l = t->left ? t->left->val : 0;
-  if (!is_leaf (t->left))
-    l *= 2;
-  int r = t->right ? t->right->val : 0;
-  if (!is_leaf (t->right))
-    r *= 2;
-  if (t->val != l + r)
-    return false;
-  return sum_tree_p (t->left) && sum_tree_p (t->right);
-}
-
-bool
-ancestors (node *t, int val)
-{
-  if (!t)
-    return false;
-  if (t->val == val)
-    return true;
-  if (ancestors (t->left, val) || ancestors (t->right, val))
-    {
-      std::cout << t->val << "\n";
+  /* Whether N is a leaf or the sum of its subtrees, taking a subtree
+     that isn't a leaf to sum to twice its root.  */
+  auto ok = [] (N n) {
+    if (!left (n) && !right (n))
       return true;
-    }
-  return false;
+    int l = left (n) ? value (left (n)) : 0;
+    if (!is_leaf (left (n)))
+      l *= 2;
+    int r = right (n) ? value (right (n)) : 0;
+    if (!is_leaf (right (n)))
+      r *= 2;
+    return value (n) == l + r;
+  };
+  return std::ranges::all_of (preorder_nodes (t), ok);
 }
 
-static int
-level_r (node *t, int val, int level)
-{
-  if (!t)
-    return 0;
-  if (t->val == val)
-    return level;
-  int l = level_r (t->left, val, level + 1);
-  if (l != 0)
-    return l;
-  l = level_r (t->right, val, level + 1);
-  return l;
-}
+/* Print the ancestors of the first VAL in preorder, nearest first.  */
 
-static void
-level (node *t, int val)
+template<typename N>
+bool
+ancestors (N t, int val)
 {
-  std::cout << "level: " << level_r (t, val, 1) << "\n";
+  return !walk_paths (t, [&] (const std::vector<N> &path) {
+    if (value (path.back ()) != val)
+      return walk::on;
+    for (std::size_t i = path.size () - 1; i-- > 0; )
+      std::cout << value (path[i]) << "\n";
+    return walk::stop;
+  });
 }
 
+template<typename N>
 static void
-print_level_r (node *t, int l, int clev)
+level (N t, int val)
 {
-  if (!t)
-    return;
-  if (clev == l)
-    {
-      std::cout << t->val << " ";
-      return;
-    }
-  print_level_r (t->left, l, clev + 1);
-  print_level_r (t->right, l, clev + 1);
+  std::size_t l = 0;
+  walk_paths (t, [&] (const std::vector<N> &path) {
+    if (value (path.back ()) != val)
+      return walk::on;
+    l = path.size ();
+    return walk::stop;
+  });
+  std::cout << "level: " << l << "\n";
 }
 
+template<typename N>
 static void
-print_level (node *t, int l)
+print_level (N t, int l)
 {
-  print_level_r (t, l, 0);
+  walk_paths (t, [&] (const std::vector<N> &path) {
+    int d = path.size () - 1;
+    if (d < l)
+      return walk::on;
+    if (d == l)
+      std::cout << value (path.back ()) << " ";
+    return walk::skip;
+  });
   std::cout << "\n";
 }
 
-static void
-duplicate (node *t)
-{
-  if (!t)
-    return;
-  node *n = new_node (t->val);
-  node *lp = t->left;
-  t->left = n;
-  n->left = lp;
-  duplicate (n->left);
-  duplicate (t->right);
-}
+/* Give each node of T a copy of itself as its left child.  */
 
+template<typename N>
 static void
-print_stk (const std::deque<node *> &d)
+duplicate (N t)
 {
-  for (auto n : d)
-    std::cout << n->val << " ";
-  std::cout << "\n";
-}
-
-static void
-print_paths_1 (node *t, std::deque<node *> &d)
-{
-  if (!t)
-    return;
-  d.push_back (t);
-  if (!t->left && !t->right)
-    print_stk (d);
-  else
+  std::vector<N> stk;
+  if (t)
+    stk.push_back (t);
+  while (!stk.empty ())
     {
-      print_paths_1 (t->left, d);
-      print_paths_1 (t->right, d);
+      N n = stk.back ();
+      stk.pop_back ();
+      N c = make_node (n, value (n));
+      set_left (c, left (n));
+      set_left (n, c);
+      if (right (n))
+	stk.push_back (right (n));
+      if (left (c))
+	stk.push_back (left (c));
     }
-  d.pop_back ();
 }
 
+template<typename N>
 static void
-print_paths (node *t)
+print_stk (const std::vector<N> &d)
 {
-  std::deque<node *> d;
-  print_paths_1 (t, d);
-}
-
-static void
-print_max_path (node *n, node *leaf, std::deque<node *> &d)
-{
-  if (!n)
-    return;
-  d.push_back (n);
-  if (n == leaf)
-    print_stk (d);
-  else
-    {
-      print_max_path (n->left, leaf, d);
-      print_max_path (n->right, leaf, d);
-    }
-  d.pop_back ();
+  for (auto n : d)
+    std::cout << value (n) << " ";
+  std::cout << "\n";
 }
 
+template<typename N>
 static void
-find_max_leaf (node *n, std::deque<node *> &d, int &max, node **leaf)
+print_paths (N t)
 {
-  if (!n)
-    return;
-  d.push_back (n);
-  if (!n->left && !n->right)
-    {
-      int cmax = 0;
-      for (auto x : d)
-	cmax += x->val;
-      if (cmax > max)
-	{
-	  max = cmax;
-	  *leaf = n;
-	}
-    }
-  else
-    {
-      find_max_leaf (n->left, d, max, leaf);
-      find_max_leaf (n->right, d, max, leaf);
-    }
-  d.pop_back ();
+  walk_paths (t, [] (const std::vector<N> &path) {
+    N n = path.back ();
+    if (!left (n) && !right (n))
+      print_stk (path);
+    return walk::on;
+  });
 }
 
+template<typename N>
 static void
-max_path (node *n)
+max_path (N n)
 {
   if (!n)
     return;
-  std::deque<node *> d;
+  /* The first leaf with the largest sum down to it, then the path down
+     to that leaf.  */
+  std::vector<int> sums;
   int max = -999999;
-  node *leaf = nullptr;
-  find_max_leaf (n, d, max, &leaf);
-  d.clear ();
-  print_max_path (n, leaf, d);
+  N leaf = null_node (n);
+  walk_paths (n, [&] (const std::vector<N> &path) {
+    N x = path.back ();
+    sums.resize (path.size () - 1);
+    sums.push_back ((sums.empty () ? 0 : sums.back ()) + value (x));
+    if (!left (x) && !right (x) && sums.back () > max)
+      {
+	max = sums.back ();
+	leaf = x;
+      }
+    return walk::on;
+  });
+  walk_paths (n, [&] (const std::vector<N> &path) {
+    if (path.back () != leaf)
+      return walk::on;
+    print_stk (path);
+    return walk::stop;
+  });
 }
 
-static void
-get_sum_paths_1 (node *n, int &sum, std::deque<node *> &d)
-{
-  if (!n)
-    return;
-  d.push_back (n);
-  if (!n->left && !n->right)
-    {
-      int s = 0;
-      int t = 1;
-      for (auto it = d.rbegin (); it != d.rend (); it++)
-	{
-	  s += t * (*it)->val;
-	  t *= 10;
-	}
-      sum += s;
-    }
-  else
-    {
-      get_sum_paths_1 (n->left, sum, d);
-      get_sum_paths_1 (n->right, sum, d);
-    }
-  d.pop_back ();
-}
+/* The sum of the numbers spelled by the paths down to the leaves, a
+   digit for each node.  */
 
+template<typename N>
 static int
-get_sum_paths (node *n)
+get_sum_paths (N n)
 {
   int sum = 0;
-  std::deque<node *> d;
-  get_sum_paths_1 (n, sum, d);
+  std::vector<int> nums;
+  walk_paths (n, [&] (const std::vector<N> &path) {
+    N x = path.back ();
+    nums.resize (path.size () - 1);
+    nums.push_back ((nums.empty () ? 0 : nums.back () * 10) + value (x));
+    if (!left (x) && !right (x))
+      sum += nums.back ();
+    return walk::on;
+  });
   return sum;
 }
 
-static node *
-get_right (node *t, int val)
+template<typename N>
+static N
+get_right (N t, int val)
 {
   if (!t)
-    return nullptr;
-  std::deque<node *> d;
+    return t;
+  std::deque<N> d;
   d.push_front (t);
   bool get_next = false;
   while (!d.empty ())
@@ -453,115 +1275,104 @@ get_right (node *t, int val)
       int sz = d.size ();
       while (sz-- > 0)
 	{
-	  node *n = d.back ();
+	  N n = d.back ();
 	  d.pop_back ();
-	  get_next |= n->val == val;
+	  get_next |= value (n) == val;
 	  if (get_next)
-	    return sz == 0 ? nullptr : d.front ();
-	  if (n->left)
-	    d.push_front (n->left);
-	  if (n->right)
-	    d.push_front (n->right);
+	    return sz == 0 ? null_node (t) : d.front ();
+	  if (left (n))
+	    d.push_front (left (n));
+	  if (right (n))
+	    d.push_front (right (n));
 	}
     }
-  return nullptr;
+  return null_node (t);
 }
 
-static void
-find_deep_left (node *root, node **n, int level, int &maxlevel, bool is_left)
-{
-  if (!root)
-    return;
-  if (is_left && !root->left && !root->right)
-    {
-      if (level > maxlevel)
-	{
-	  *n = root;
-	  maxlevel = level;
-	}
-    }
-  find_deep_left (root->left, n, level + 1, maxlevel, true);
-  find_deep_left (root->right, n, level + 1, maxlevel, false);
-}
+/* The deepest leaf that is a left child, below the root.  */
 
-static node *
-deep_left (node *t)
+template<typename N>
+static N
+deep_left (N t)
 {
-  node *n = nullptr;
-  int maxlevel = 0;
-  find_deep_left (t, &n, 0, maxlevel, true);
+  N n = null_node (t);
+  std::size_t maxlevel = 1;
+  walk_paths (t, [&] (const std::vector<N> &path) {
+    N x = path.back ();
+    std::size_t level = path.size ();
+    if (level > maxlevel && !left (x) && !right (x)
+	&& left (path[level - 2]) == x)
+      {
+	n = x;
+	maxlevel = level;
+      }
+    return walk::on;
+  });
   return n;
 }
 
+template<typename N>
 static void
-left_view_1 (node *t, int &level_done, int clev)
+left_view (N t)
 {
-  if (!t)
-    return;
-  if (level_done < clev)
-    {
-      std::cout << t->val << "\n";
-      level_done = clev;
-    }
-  left_view_1 (t->left, level_done, clev + 1);
-  left_view_1 (t->right, level_done, clev + 1);
-}
-
-static void
-left_view (node *t)
-{
-  int level_done = 0;
-  left_view_1 (t, level_done, 1);
+  std::size_t level_done = 0;
+  walk_paths (t, [&] (const std::vector<N> &path) {
+    if (level_done < path.size ())
+      {
+	std::cout << value (path.back ()) << "\n";
+	level_done = path.size ();
+      }
+    return walk::on;
+  });
 }
 
+template<typename N>
 static bool
-same_level_1 (node *t, int &leaf_level, int clev)
+same_level (N t)
 {
-  if (!t)
-    return true;
-  if (!t->left && !t->right)
-    {
-      if (leaf_level == 0)
-	leaf_level = clev;
-      else if (leaf_level != clev)
-	return false;
-    }
-  return (same_level_1 (t->left, leaf_level, clev + 1)
-	  && same_level_1 (t->right, leaf_level, clev + 1));
-}
-
-static bool
-same_level (node *t)
-{
-  int leaf_level = 0;
-  return same_level_1 (t, leaf_level, 1);
+  std::size_t leaf_level = 0;
+  return walk_paths (t, [&] (const std::vector<N> &path) {
+    N n = path.back ();
+    if (left (n) || right (n))
+      return walk::on;
+    if (leaf_level == 0)
+      leaf_level = path.size ();
+    return leaf_level == path.size () ? walk::on : walk::stop;
+  });
 }
 
+template<typename N>
 static int
-find_max (node *t)
+find_max (N t, fork_join *pool = nullptr)
 {
-  if (!t)
-    return INT_MIN;
-  int m = std::max (find_max (t->left), find_max (t->right));
-  return std::max (m, t->val);
+  if (pool)
+    return fold (t, INT_MIN, [] (N n, int l, int r) {
+      return std::max ({ value (n), l, r });
+    }, pool);
+  int m = INT_MIN;
+  for (N n : preorder_nodes (t))
+    m = std::max (m, value (n));
+  return m;
 }
 
+/* Append to V the values down to the first A in preorder.  */
+
+template<typename N>
 static bool
-find_path (node *t, int a, std::vector<int> &v)
+find_path (N t, int a, std::vector<int> &v)
 {
-  if (!t)
-    return false;
-  v.push_back (t->val);
-  if (t->val == a)
-    return true;
-  if (find_path (t->left, a, v) || find_path (t->right, a, v))
-    return true;
-  v.pop_back ();
-  return false;
+  return !walk_paths (t, [&] (const std::vector<N> &path) {
+    if (value (path.back ()) != a)
+      return walk::on;
+    for (N n : path)
+      v.push_back (value (n));
+    return walk::stop;
+  });
 }
 
+template<typename N>
 static int
-dist (node *t, int a, int b)
+dist (N t, int a, int b)
 {
   std::vector<int> pa, pb;
   if (!find_path (t, a, pa) || !find_path (t, b, pb))
@@ -573,24 +1384,27 @@ dist (node *t, int a, int b)
   return pa.size () - i + pb.size () - i;
 }
 
-static int
-fill_height (int parent[], int h[], int i)
+
+/* Climb from I to the root or to a node whose height is known, then
+   fill in the heights on the way back down.  UP is scratch space.  */
+
+static void
+fill_height (int parent[], int h[], int i, std::vector<int> &up)
 {
-  if (parent[i] == -1)
+  for (; h[i] == 0 && parent[i] != -1; i = parent[i])
+    up.push_back (i);
+  if (h[i] == 0)
     h[i] = 1;
-  else if (h[i] == 0)
-    h[i] = fill_height (parent, h, parent[i]) + 1;
-  return h[i];
+  for (; !up.empty (); up.pop_back ())
+    h[up.back ()] = h[parent[up.back ()]] + 1;
 }
 
 static int
 get_height (int parent[], int n)
 {
-  int *h = new int[n];
-  for (int i = 0; i < n; ++i)
-    h[i] = 0;
+  std::vector<int> h (n), up;
   for (int i = 0; i < n; ++i)
-    fill_height (parent, h, i);
+    fill_height (parent, h.data (), i, up);
   int r = h[0];
   for (int i = 1; i < n; i++)
     if (h[i] > r)
@@ -598,12 +1412,13 @@ get_height (int parent[], int n)
   return r;
 }
 
+template<typename N>
 static void
-print_levels (node *t, int lo, int hi)
+print_levels (N t, int lo, int hi)
 {
   if (!t)
     return;
-  std::deque<node *> d;
+  std::deque<N> d;
   d.push_front (t);
   int clev = 1;
   while (!d.empty ())
@@ -611,20 +1426,230 @@ print_levels (node *t, int lo, int hi)
       int sz = d.size ();
       while (sz-- > 0)
 	{
-	  node *n = d.back ();
+	  N n = d.back ();
 	  d.pop_back ();
 	  if (clev >= lo && clev <= hi)
-	    std::cout << n->val << " ";
-	  if (n->left)
-	    d.push_front (n->left);
-	  if (n->right)
-	    d.push_front (n->right);
+	    std::cout << value (n) << " ";
+	  if (left (n))
+	    d.push_front (left (n));
+	  if (right (n))
+	    d.push_front (right (n));
 	}
       clev++;
       std::cout << "\n";
     }
 }
 
+/* Allocates on cache-line boundaries, for arrays that are read a line
+   at a time.  */
+
+template<typename T>
+struct line_allocator
+{
+  using value_type = T;
+  static constexpr std::align_val_t line{64};
+
+  line_allocator () = default;
+  template<typename U> line_allocator (const line_allocator<U> &) {}
+
+  T *allocate (std::size_t n)
+  {
+    return static_cast<T *> (::operator new (n * sizeof (T), line));
+  }
+  void deallocate (T *p, std::size_t) { ::operator delete (p, line); }
+
+  bool operator== (const line_allocator &) const { return true; }
+};
+
+/* A tree stored without pointers, in breadth-first order as in a binary
+   heap (Eytzinger's layout): slot 1 is the root, slot K has its children
+   in slots 2K and 2K + 1, and level D (the root being level 1) is slots
+   2^(D - 1) to 2^D - 1.  A walk by levels is then a sweep through memory.
+
+   A complete tree fills slots 1 to N exactly.  Any other shape leaves
+   holes, which hold INT_MIN; a chain of N nodes would need 2^N - 1 slots,
+   so check eytzinger_slots first for a tree that may be far from
+   complete.  The tree is a copy: changes to either don't show in the
+   other.  */
+
+class eytzinger_tree
+{
+public:
+  eytzinger_tree () = default;
+
+  /* T, laid out.  */
+  template<typename N>
+  explicit eytzinger_tree (N t)
+  {
+    const std::uint64_t n = slots_for (t, [] (N, std::uint64_t) {});
+    /* A tree too deep for any memory makes the allocation fail.  */
+    const std::size_t size = std::min<std::uint64_t> (n, SIZE_MAX - 1) + 1;
+    val_.assign (size, INT_MIN);
+    here_.assign (size, false);
+    holes_ = n;
+    slots_for (t, [&] (N c, std::uint64_t k) {
+      val_[k] = ::value (c);
+      here_[k] = true;
+      --holes_;
+    });
+  }
+
+  /* The tree that buildp makes from PARENT.  */
+  eytzinger_tree (int parent[], int n)
+  {
+    tree_arena a (n);
+    *this = eytzinger_tree (buildp (a, parent, n));
+  }
+
+  /* The complete binary search tree of the N values from V, which are in
+     ascending order, for lower_bound.  */
+  static eytzinger_tree sorted (const int *v, std::size_t n)
+  {
+    eytzinger_tree e;
+    e.val_.resize (n + 1);
+    e.here_.assign (n + 1, true);
+    e.here_[0] = false;
+    /* Walk the slots in order: down to the leftmost, then after each
+       slot the leftmost of its right subtree, or up past the right
+       children to the next parent.  */
+    std::size_t k = 1;
+    while (2 * k <= n)
+      k *= 2;
+    for (std::size_t i = 0; i < n; ++i)
+      {
+	e.val_[k] = v[i];
+	if (2 * k + 1 <= n)
+	  for (k = 2 * k + 1; 2 * k <= n; k *= 2)
+	    ;
+	else
+	  k = (k >> std::countr_one (k)) >> 1;
+      }
+    return e;
+  }
+
+  /* Slots, holes included; the last one is never a hole.  */
+  std::size_t slots () const { return val_.size () - 1; }
+  bool complete () const { return holes_ == 0; }
+  bool has (std::size_t k) const { return k < here_.size () && here_[k]; }
+  int value (std::size_t k) const { return val_[k]; }
+
+  /* Number of levels.  */
+  int height () const { return std::bit_width (slots ()); }
+
+  /* The slot of the first value not less than X, in order, or 0 if
+     there is none.  The tree must be a complete binary search tree, like
+     those from sorted.
+
+     There is no branch on the comparison: each step goes to slot 2K or
+     2K + 1, and the answer is the last slot where it went left, found
+     from the trailing ones of K at the end.  So the loads don't wait for
+     a mispredicted branch, and meanwhile the prefetch fetches the line
+     of the sixteen descendants four levels down (grandchildren and
+     below), so a lookup keeps several cache misses in flight at once.  */
+  std::size_t lower_bound (int x) const
+  {
+    const int *v = val_.data ();
+    const std::size_t n = slots ();
+    std::size_t k = 1;
+    while (k <= n)
+      {
+	__builtin_prefetch (v + 16 * k);
+	k = 2 * k + (v[k] < x);
+      }
+    return k >> (std::countr_one (k) + 1);
+  }
+
+  /* The largest value, by a sweep over all the slots.  */
+  int max () const
+  {
+    int m = INT_MIN;
+    for (std::size_t k = 1; k < val_.size (); ++k)
+      m = std::max (m, val_[k]);
+    return m;
+  }
+
+private:
+  /* Call F (N, K) for each node N of T, in level order, with its slot
+     K, and return the last slot, or UINT64_MAX if slots run out.  */
+  template<typename N, typename F>
+  static std::uint64_t slots_for (N t, F f)
+  {
+    std::vector<std::pair<N, std::uint64_t>> q;
+    if (t)
+      q.emplace_back (t, 1);
+    for (std::size_t i = 0; i < q.size (); ++i)
+      {
+	auto [c, k] = q[i];
+	f (c, k);
+	if ((left (c) || right (c)) && k > UINT64_MAX / 2 - 1)
+	  return UINT64_MAX;
+	if (left (c))
+	  q.emplace_back (left (c), 2 * k);
+	if (right (c))
+	  q.emplace_back (right (c), 2 * k + 1);
+      }
+    return q.empty () ? 0 : q.back ().second;
+  }
+
+  template<typename N>
+  friend std::uint64_t eytzinger_slots (N t);
+
+  std::vector<int, line_allocator<int>> val_ = { INT_MIN };
+  std::vector<bool> here_ = { false };
+  std::size_t holes_ = 0;
+};
+
+/* The slots that eytzinger_tree (T) would take.  */
+
+template<typename N>
+std::uint64_t
+eytzinger_slots (N t)
+{
+  return eytzinger_tree::slots_for (t, [] (N, std::uint64_t) {});
+}
+
+/* find_max, level and print_levels for eytzinger_tree, as sweeps over
+   its slots.  */
+
+static int
+find_max (const eytzinger_tree &t)
+{
+  return t.max ();
+}
+
+/* Unlike level on the other trees, which finds the first VAL in
+   preorder, this finds the one nearest the root.  */
+
+static void
+level (const eytzinger_tree &t, int val)
+{
+  int l = 0;
+  for (std::size_t k = 1; k <= t.slots (); ++k)
+    if (t.value (k) == val && t.has (k))
+      {
+	l = std::bit_width (k);
+	break;
+      }
+  std::cout << "level: " << l << "\n";
+}
+
+static void
+print_levels (const eytzinger_tree &t, int lo, int hi)
+{
+  for (int l = 1; l <= t.height (); ++l)
+    {
+      if (l >= lo && l <= hi)
+	{
+	  const std::size_t last = std::min (t.slots (),
+					     (std::size_t (1) << l) - 1);
+	  for (std::size_t k = std::size_t (1) << (l - 1); k <= last; ++k)
+	    if (t.has (k))
+	      std::cout << t.value (k) << " ";
+	}
+      std::cout << "\n";
+    }
+}
+
 static void
 print_range (const std::vector<int> &buffer, int l, int h)
 {
@@ -633,22 +1658,27 @@ print_range (const std::vector<int> &buffer, int l, int h)
   std::cout << "\n";
 }
 
+/* Print each path down the tree that sums to SUM, continuing the one in
+   BUFFER.  */
+
+template<typename N>
 static void
-find_sum (node *t, int sum, std::vector<int> &buffer)
+find_sum (N t, int sum, std::vector<int> &buffer)
 {
-  if (!t)
-    return;
-  buffer.push_back (t->val);
-  int tmp = sum;
-  for (int i = buffer.size () - 1; i >= 0; i--)
-    {
-      tmp -= buffer[i];
-      if (tmp == 0)
-	print_range (buffer, i, buffer.size () - 1);
-    }
-  find_sum (t->left, sum, buffer);
-  find_sum (t->right, sum, buffer);
-  buffer.pop_back ();
+  const std::size_t base = buffer.size ();
+  walk_paths (t, [&] (const std::vector<N> &path) {
+    buffer.resize (base + path.size () - 1);
+    buffer.push_back (value (path.back ()));
+    int tmp = sum;
+    for (int i = buffer.size () - 1; i >= 0; i--)
+      {
+	tmp -= buffer[i];
+	if (tmp == 0)
+	  print_range (buffer, i, buffer.size () - 1);
+      }
+    return walk::on;
+  });
+  buffer.resize (base);
 }
 
 int
@@ -894,4 +1924,302 @@ main ()
   std::vector<int> v;
   std::cout << "find sum\n";
   find_sum (root19, 9, v);
+
+  /* The same trees in a tree_arena come out the same.  */
+  auto printed = [] (auto t) {
+    std::ostringstream os;
+    std::streambuf *old = std::cout.rdbuf (os.rdbuf ());
+    preorder (t);
+    inorder (t);
+    postorder (t);
+    std::cout.rdbuf (old);
+    return os.str ();
+  };
+  tree_arena arena;
+  tref a1 = buildp (arena, parent, 7);
+  if (printed (a1) != printed (buildp (parent, 7)))
+    __builtin_abort ();
+  tref a2 = buildpost (arena, in, post, 8);
+  if (printed (a2) != printed (buildpost (in, post, 8)))
+    __builtin_abort ();
+  if (!id (a2, a2) || id (a1, a2))
+    __builtin_abort ();
+  mirror (a2);
+  duplicate (a2);
+  node *p2 = buildpost (in, post, 8);
+  mirror (p2);
+  duplicate (p2);
+  if (printed (a2) != printed (p2)
+      || get_sum_paths (a2) != get_sum_paths (p2)
+      || dist (a2, 4, 7) != dist (p2, 4, 7)
+      || value (deep_left (a2)) != value (deep_left (p2)))
+    __builtin_abort ();
+
+  /* A complete tree of 1000 nodes.  */
+  std::vector<int> parent3 (1000);
+  for (int i = 0; i < 1000; ++i)
+    parent3[i] = (i - 1) >> 1;
+  tree_arena arena2 (1000);
+  tref a3 = buildp (arena2, parent3.data (), 1000);
+  node *p3 = buildp (parent3.data (), 1000);
+  int ha = 0, hp = 0;
+  if (height (a3) != 10 || !balanced_p (a3) || find_max (a3) != 999
+      || diameter2 (a3, &ha) != diameter2 (p3, &hp) || ha != hp
+      || diameter (a3) != diameter2 (p3, &hp))
+    __builtin_abort ();
+
+  /* Released nodes are reused before the arena grows.  */
+  std::size_t cap = arena2.capacity ();
+  tref leaf = left (left (left (a3)));
+  while (left (leaf))
+    leaf = left (leaf);
+  arena2.release (leaf);
+  if (value (arena2.new_node (7)) != 7 || arena2.capacity () != cap)
+    __builtin_abort ();
+  arena2.new_node (8);
+  if (arena2.capacity () != cap + 1)
+    __builtin_abort ();
+  arena2.clear ();
+  if (arena2.capacity () != 0)
+    __builtin_abort ();
+
+  /* The four orders, lazily.  */
+  auto values = [] (auto &&nodes) {
+    std::vector<int> v;
+    for (auto n : nodes)
+      v.push_back (value (n));
+    return v;
+  };
+  tref a4 = buildpost (arena, in, post, 8);
+  if (values (inorder_nodes (a4)) != std::vector<int> (in, in + 8)
+      || values (postorder_nodes (a4)) != std::vector<int> (post, post + 8)
+      || (values (preorder_nodes (a4))
+	  != std::vector<int> { 1, 2, 4, 8, 5, 3, 6, 7 })
+      || (values (levelorder_nodes (a4))
+	  != std::vector<int> { 1, 2, 3, 4, 5, 6, 7, 8 }))
+    __builtin_abort ();
+
+  /* Stopping early.  */
+  auto it = std::ranges::find_if (inorder_nodes (root2), [] (node *n) {
+    return n->val == 5;
+  });
+  if (*std::next (it) != root2)
+    __builtin_abort ();
+
+  /* Morris agrees, and leaves the tree as it found it, even when it's
+     stopped.  */
+  std::string before = printed (a4);
+  std::vector<int> mi, mp;
+  morris_inorder (a4, [&] (tref n) { mi.push_back (value (n)); });
+  morris_preorder (a4, [&] (tref n) { mp.push_back (value (n)); });
+  if (mi != values (inorder_nodes (a4)) || mp != values (preorder_nodes (a4)))
+    __builtin_abort ();
+  int seen = 0;
+  morris_inorder (a4, [&] (tref) { return ++seen < 3; });
+  morris_preorder (root2, [&] (node *) { return ++seen < 5; });
+  if (seen != 5 || printed (a4) != before)
+    __builtin_abort ();
+
+  /* Nothing here recurses, so a chain of a million nodes is fine.  */
+  constexpr int deep = 1000000;
+  std::vector<int> chain (deep);
+  for (int i = 0; i < deep; ++i)
+    chain[i] = i - 1;
+  tree_arena arena3 (deep);
+  tref a5 = buildp (arena3, chain.data (), deep);
+  for (int pass = 0; pass < 2; ++pass)
+    {
+      int h5 = 0;
+      if (height (a5) != deep || diameter2 (a5, &h5) != deep || h5 != deep
+	  || balanced_p (a5) || find_max (a5) != deep - 1 || !id (a5, a5)
+	  || value (*inorder_nodes (a5).begin ()) != (pass ? 0 : deep - 1)
+	  || value (*postorder_nodes (a5).begin ()) != deep - 1
+	  || std::ranges::distance (levelorder_nodes (a5)) != deep)
+	__builtin_abort ();
+      long sum = 0;
+      morris_inorder (a5, [&] (tref n) { sum += value (n); });
+      if (sum != long (deep) * (deep - 1) / 2)
+	__builtin_abort ();
+      /* And again down the right.  */
+      mirror (a5);
+    }
+
+  /* Nor do the walks that keep the path down to each node.  */
+  tree_arena arena5 (2 * deep);
+  tref a7 = buildp (arena5, chain.data (), deep);
+  for (int pass = 0; pass < 2; ++pass)
+    {
+      std::ostringstream os;
+      std::streambuf *old = std::cout.rdbuf (os.rdbuf ());
+      level (a7, deep - 1);
+      print_level (a7, deep - 1);
+      std::cout.rdbuf (old);
+      std::vector<int> p;
+      if (os.str () != "level: 1000000\n999999 \n"
+	  || dist (a7, 0, deep - 1) != deep - 1 || dist (a7, 10, 20) != 10
+	  || !find_path (a7, deep - 1, p) || p != values (preorder_nodes (a7))
+	  || !same_level (a7))
+	__builtin_abort ();
+      mirror (a7);
+    }
+  duplicate (a7);
+  tref last = a7;
+  for (tref n : preorder_nodes (a7))
+    {
+      value (n) = 1;
+      last = n;
+    }
+  if (height (a7) != 2 * deep || !has_sum (a7, 2 * deep)
+      || has_sum (a7, deep) || deep_left (a7) != last || !same_level (a7))
+    __builtin_abort ();
+
+  /* The same queries on the trees laid out implicitly.  */
+  auto output = [] (auto f) {
+    std::ostringstream os;
+    std::streambuf *old = std::cout.rdbuf (os.rdbuf ());
+    f ();
+    std::cout.rdbuf (old);
+    return os.str ();
+  };
+  const eytzinger_tree e9 (root9), e18 (root18);
+  for (int x : { 7, 17, 4, 5, 1, 2, 3 })
+    if (output ([&] { level (e9, x); }) != output ([&] { level (root9, x); }))
+      __builtin_abort ();
+  for (int lo = 0; lo <= 5; ++lo)
+    if (output ([&] { print_levels (e18, lo, lo + 2); })
+	!= output ([&] { print_levels (root18, lo, lo + 2); }))
+      __builtin_abort ();
+  if (find_max (eytzinger_tree (root15)) != find_max (root15)
+      || find_max (eytzinger_tree (root16)) != find_max (root16)
+      || find_max (eytzinger_tree ((node *) nullptr)) != INT_MIN
+      || e18.complete () || e18.slots () != 11 || e18.height () != 4)
+    __builtin_abort ();
+  const eytzinger_tree e1 (parent, 7);
+  if (output ([&] { print_levels (e1, 1, 4); })
+      != output ([&] { print_levels (root1, 1, 4); }))
+    __builtin_abort ();
+  const eytzinger_tree e3 (parent3.data (), 1000);
+  if (!e3.complete () || e3.slots () != 1000 || e3.height () != 10
+      || find_max (e3) != 999 || e3.value (1) != 0 || e3.value (1000) != 999)
+    __builtin_abort ();
+  /* A chain takes a slot per level, and is full of holes.  */
+  if (eytzinger_slots (buildp (arena, chain.data (), 10)) != 512
+      || eytzinger_slots (a5) != UINT64_MAX)
+    __builtin_abort ();
+
+  /* Searching agrees with std::lower_bound, for every shape of complete
+     tree up to 70 nodes, and a large one.  */
+  std::vector<int> evens;
+  for (int n = 0; n <= 1000; n = n < 70 ? n + 1 : 1000)
+    {
+      evens.clear ();
+      for (int i = 0; i < n; ++i)
+	evens.push_back (2 * i);
+      const eytzinger_tree e = eytzinger_tree::sorted (evens.data (), n);
+      if (!e.complete () || int (e.slots ()) != n
+	  || (n && find_max (e) != 2 * n - 2))
+	__builtin_abort ();
+      for (int x = -1; x <= 2 * n; ++x)
+	{
+	  auto lb = std::lower_bound (evens.begin (), evens.end (), x);
+	  std::size_t k = e.lower_bound (x);
+	  if (lb == evens.end () ? k != 0 : k == 0 || e.value (k) != *lb)
+	    __builtin_abort ();
+	}
+      if (n == 1000)
+	break;
+    }
+
+  /* In parallel, the results are the same, whatever the shape and the
+     number of threads.  Here on random binary search trees, made twice
+     for left_sum to change one of them.  Their values are below 2^12,
+     so that the sums of all 20000 fit in an int.  */
+  auto random_tree = [] (tree_arena &a, unsigned seed) {
+    tref t = a.null ();
+    for (int i = 0; i < 20000; ++i)
+      {
+	seed = seed * 1103515245 + 12345;
+	const int x = seed >> 20;
+	tref n = a.new_node (x);
+	if (!t)
+	  t = n;
+	for (tref c = t; c != n; )
+	  {
+	    tref next = x < value (c) ? left (c) : right (c);
+	    if (!next && x < value (c))
+	      set_left (c, n);
+	    else if (!next)
+	      set_right (c, n);
+	    c = next ? next : n;
+	  }
+      }
+    return t;
+  };
+  /* arena2 was cleared, so make the complete tree of 1000 again.  */
+  tree_arena arena4 (1000);
+  tref a6 = buildp (arena4, parent3.data (), 1000);
+  for (unsigned threads : { 1, 2, 5 })
+    {
+      fork_join pool (threads);
+      tree_arena ra, rb;
+      tref r1 = random_tree (ra, threads), r2 = random_tree (rb, threads);
+      for (tref t : { r1, a6, a5, ra.null () })
+	{
+	  int h1 = 0, h2 = 0;
+	  if (height (t, &pool) != height (t)
+	      || diameter2 (t, &h1, &pool) != diameter2 (t, &h2) || h1 != h2
+	      || find_max (t, &pool) != find_max (t)
+	      || check_height (t, &pool) != check_height (t)
+	      || sum_p (t, &pool) != sum_p (t))
+	    __builtin_abort ();
+	}
+      if (left_sum (r1, &pool) != left_sum (r2) || !id (r1, r2)
+	  || sum_p (root7, &pool) != sum_p (root7)
+	  || sum_p (root8, &pool) != sum_p (root8)
+	  || !balanced_p (a6, &pool) || balanced_p (r1, &pool))
+	__builtin_abort ();
+
+      /* Forks nest, and the pool runs them all.  */
+      std::atomic<int> calls = 0;
+      auto count = [&] (auto &self, int depth) -> void {
+	if (depth == 0)
+	  {
+	    ++calls;
+	    return;
+	  }
+	pool.both ([&] { self (self, depth - 1); },
+		   [&] { self (self, depth - 1); });
+      };
+      count (count, 10);
+      if (calls != 1024)
+	__builtin_abort ();
+    }
+
+  /* The builders give back the trees their traversals came from, in
+     linear time: also a random one, with its nodes numbered in preorder
+     so that no two are alike, and chains of a million nodes.  */
+  int pre[] = { 1, 2, 4, 8, 5, 3, 6, 7 };
+  if (!id (buildpre (in, pre, 8), root2)
+      || buildpost (arena, in, post, 0) || buildpre (arena, in, pre, 0))
+    __builtin_abort ();
+  tree_arena ra, rb;
+  tref r = random_tree (ra, 7);
+  int label = 0;
+  for (tref n : preorder_nodes (r))
+    value (n) = label++;
+  auto rebuilds = [&] (tref t) {
+    auto vin = values (inorder_nodes (t));
+    auto vpre = values (preorder_nodes (t));
+    auto vpost = values (postorder_nodes (t));
+    const int n = vin.size ();
+    rb.clear ();
+    return (id (buildpost (rb, vin.data (), vpost.data (), n), t)
+	    && id (buildpre (rb, vin.data (), vpre.data (), n), t)
+	    && rb.capacity () == 2 * std::size_t (n));
+  };
+  if (!rebuilds (r) || !rebuilds (a5))
+    __builtin_abort ();
+  mirror (a5);
+  if (!rebuilds (a5))
+    __builtin_abort ();
 }
@@ -0,0 +1,169 @@
+// Integers that check their arithmetic for overflow.
+
+#ifndef _GOO_CHECKED_H
+#define _GOO_CHECKED_H 1
+
+#if __cplusplus > 201703L && __cpp_concepts >= 201907L
+
+#include <compare>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+/* What checked<I, P> does when an operation overflows I:
+
+   unchecked  wrap around, even if I is signed;
+   trap       stop the program with __builtin_trap;
+   saturate   give the smallest or the largest value of I instead;
+   report     wrap around, and remember it: overflowed () is then true
+	      for this value and every value computed from it;
+   widen      compute the exact result in a wider type instead (I can
+	      be at most 64 bits wide).
+
+   Everything is built on GCC's __builtin_{add,sub,mul}_overflow.  As
+   overflows.cc shows, those compile to the operation itself followed by
+   a jump or a set on the overflow or carry flag, rather than comparisons
+   on the operands, so trap costs one predictable branch, and unchecked
+   nothing at all.  */
+
+namespace overflow {
+  struct unchecked {};
+  struct trap {};
+  struct saturate {};
+  struct report {};
+  struct widen {};
+}
+
+/* A type that can hold any product of two I's.  */
+
+template<std::integral I>
+using wider_t = std::conditional_t<
+  (sizeof (I) < sizeof (std::int64_t)),
+  std::conditional_t<std::is_signed_v<I>, std::int64_t, std::uint64_t>,
+  std::conditional_t<std::is_signed_v<I>, __int128, unsigned __int128>>;
+
+template<std::integral I, typename P = overflow::trap>
+class checked {
+  static_assert (!std::is_same_v<P, overflow::widen>
+		 || sizeof (I) <= sizeof (std::int64_t));
+  static constexpr bool reporting = std::is_same_v<P, overflow::report>;
+  struct none {};
+
+public:
+  constexpr checked () = default;
+  constexpr checked (I v) : v_(v) {}
+
+  constexpr I value () const { return v_; }
+  constexpr explicit operator I () const { return v_; }
+
+  /* Whether this value, or one it was computed from, overflowed.  Only
+     the report policy keeps track.  */
+  constexpr bool overflowed () const
+  {
+    if constexpr (reporting)
+      return ovf_;
+    else
+      return false;
+  }
+
+  friend constexpr auto operator+ (checked a, checked b)
+  {
+    if constexpr (std::is_same_v<P, overflow::widen>)
+      return wider_t<I> (a.v_) + b.v_;
+    else
+      {
+	I r;
+	const bool o = __builtin_add_overflow (a.v_, b.v_, &r);
+	/* Only a positive B can go over the top.  */
+	return finish (r, o, b.v_ > 0, a, b);
+      }
+  }
+
+  friend constexpr auto operator- (checked a, checked b)
+  {
+    if constexpr (std::is_same_v<P, overflow::widen>)
+      return wider_t<I> (a.v_) - b.v_;
+    else
+      {
+	I r;
+	const bool o = __builtin_sub_overflow (a.v_, b.v_, &r);
+	return finish (r, o, b.v_ < 0, a, b);
+      }
+  }
+
+  friend constexpr auto operator* (checked a, checked b)
+  {
+    if constexpr (std::is_same_v<P, overflow::widen>)
+      return wider_t<I> (a.v_) * b.v_;
+    else
+      {
+	I r;
+	const bool o = __builtin_mul_overflow (a.v_, b.v_, &r);
+	return finish (r, o, (a.v_ < 0) == (b.v_ < 0), a, b);
+      }
+  }
+
+  /* A << S overflows if any bit that matters is shifted out, including
+     the sign bit; that's the same thing as multiplying by 2^S.  */
+  friend constexpr auto operator<< (checked a, int s)
+  {
+    using U = std::make_unsigned_t<I>;
+    if constexpr (std::is_same_v<P, overflow::widen>)
+      return wider_t<I> (a.v_) << s;
+    else if (s >= std::numeric_limits<U>::digits)
+      return finish (I (0), a.v_ != 0, a.v_ > 0, a, a);
+    else
+      {
+	I r;
+	const bool o = __builtin_mul_overflow (a.v_, U (1) << s, &r);
+	return finish (r, o, a.v_ > 0, a, a);
+      }
+  }
+
+  friend constexpr bool operator== (checked a, checked b)
+  {
+    return a.v_ == b.v_;
+  }
+
+  friend constexpr auto operator<=> (checked a, checked b)
+  {
+    return a.v_ <=> b.v_;
+  }
+
+  checked &operator+= (checked b) { return *this = *this + b; }
+  checked &operator-= (checked b) { return *this = *this - b; }
+  checked &operator*= (checked b) { return *this = *this * b; }
+  checked &operator<<= (int s) { return *this = *this << s; }
+
+private:
+  /* The result of an operation on A and B: R, unless O says it
+     overflowed, in which direction UP says.  */
+  static constexpr checked finish (I r, bool o, [[maybe_unused]] bool up,
+				   [[maybe_unused]] checked a,
+				   [[maybe_unused]] checked b)
+  {
+    checked c (r);
+    if constexpr (reporting)
+      c.ovf_ = o || a.ovf_ || b.ovf_;
+    else if constexpr (std::is_same_v<P, overflow::trap>)
+      {
+	if (o)
+	  __builtin_trap ();
+      }
+    else if constexpr (std::is_same_v<P, overflow::saturate>)
+      {
+	if (o)
+	  c.v_ = (up ? std::numeric_limits<I>::max ()
+		  : std::numeric_limits<I>::min ());
+      }
+    return c;
+  }
+
+  I v_ = 0;
+  [[no_unique_address]] std::conditional_t<reporting, bool, none> ovf_{};
+};
+
+#endif // C++20
+
+#endif // _GOO_CHECKED_H
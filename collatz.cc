@@ -2,27 +2,407 @@
 // Unsolved problem in mathematics:
 // Does the Collatz sequence eventually reach 1 for all positive integer
 // initial values?
+// Use -std=c++20 -O2 -pthread.  Run with A B [THREADS] to scan [A, B].
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define assert(X) do { if (!(X)) std::abort (); } while(0)
+
+using u64 = std::uint64_t;
+using u128 = unsigned __int128;
+
+/* Append N in decimal to S.  */
 
 static void
-collatz (unsigned long n)
+append (std::string &s, u128 n)
 {
-  __builtin_printf ("n == %lu:", n);
-  while (n != 1)
+  char buf[40];
+  char *p = buf + sizeof buf;
+  do
+    *--p = '0' + int (n % 10);
+  while (n /= 10);
+  s.append (p, buf + sizeof buf);
+}
+
+/* Print the trajectory of N to OUT, if OUT isn't null, all in one go
+   rather than a printf per step.  Values that no longer fit in 64 bits
+   carry on in 128.  Returns the number of steps it took to reach 1.  */
+
+static unsigned
+collatz (u64 n, std::FILE *out = stdout)
+{
+  std::string buf;
+  if (out)
+    {
+      buf = "n == ";
+      append (buf, n);
+      buf += ':';
+    }
+  unsigned steps = 0;
+  for (u128 x = n; x != 1; ++steps)
     {
-      if ((n & 1) == 0)
-	n /= 2;
+      if ((x & 1) == 0)
+	x /= 2;
       else
-	n = 3 * n + 1;
-      __builtin_printf (" -> %lu", n);
+	{
+	  assert (x < ~u128 (0) / 3);
+	  x = 3 * x + 1;
+	}
+      if (out)
+	{
+	  buf += " -> ";
+	  append (buf, x);
+	}
     }
-  __builtin_printf ("\n");
+  if (out)
+    {
+      buf += '\n';
+      std::fwrite (buf.data (), 1, buf.size (), out);
+    }
+  return steps;
+}
+
+/* The trajectory of N: the number of steps to reach 1 (the total
+   stopping time) and the largest value on the way (the excursion).  */
+
+struct chain {
+  u64 n = 0;
+  unsigned steps = 0;
+  u128 peak = 0;
+};
+
+/* What scan reports about a range: the longest chain and the one that
+   climbs the highest, the smallest starting value on ties.  */
+
+struct scan_result {
+  chain longest;
+  chain highest;
+};
+
+/* Stopping times and excursions of many starting values at once.
+
+   Write T (x) for x / 2 or (3x + 1) / 2, which is one step or two.  If
+   x = 2^k h + l with l < 2^k, the parity of T^i (x) for i < k depends
+   only on l, so
+
+     T^k (x) = 3^c h + T^k (l),
+
+   where c is the number of odd values among x, ..., T^(k-1) (x).  A
+   table of c and T^k (l) for every l takes k steps at a time with one
+   multiplication.  Once the trajectory drops below 2^memo_bits, a memo
+   of every smaller value's stopping time and excursion finishes it.
+
+   The excursion is always 3y + 1 for some odd y on the way, or N itself.
+   Within a jump those are 3^(c_i + 1) 2^(k - i) h + 3 T^i (l) + 1, so
+   the jump table also keeps the largest of each term, which bounds the
+   excursion of the whole jump.  Only when that bound beats the best so
+   far do we take the k steps one at a time to find the exact value.
+
+   Values above 2^64 are rare (the first start to get there is
+   12327829503) and when a jump would overflow, we finish the trajectory
+   one step at a time in 128 bits.  */
+
+class collatz_engine {
+  struct jump {
+    std::uint32_t d;		// T^k (l)
+    std::uint32_t c;		// odd steps among the k
+    std::uint32_t peak_mul;	// max 3^(c_i + 1) 2^(k - i) over odd T^i (l)
+    std::uint32_t peak_add;	// max 3 T^i (l) + 1 over odd T^i (l)
+  };
+
+  int k;
+  u64 memo_limit;
+  u64 memo_peak_max = 0;
+  u64 peak_mul_max = 0;
+  u64 peak_add_max = 0;
+  std::vector<jump> jumps;
+  std::vector<std::uint16_t> memo_steps;
+  std::vector<u64> memo_peak;
+  u64 pow3[33];
+
+  /* The exact excursion of the K steps starting from X, by taking them
+     one at a time.  */
+  u128 block_peak (u128 x) const
+  {
+    u128 p = x;
+    for (int i = 0; i < k; ++i)
+      if (x & 1)
+	{
+	  x = 3 * x + 1;
+	  p = std::max (p, x);
+	  x /= 2;
+	}
+      else
+	x /= 2;
+    return p;
+  }
+
+  /* Finish the trajectory of C from X in 128 bits, S steps in.  */
+  void slow (chain &c, u128 x, unsigned s) const
+  {
+    while (x >= memo_limit)
+      {
+	if (x & 1)
+	  {
+	    assert (x < ~u128 (0) / 3);
+	    x = 3 * x + 1;
+	    c.peak = std::max (c.peak, x);
+	  }
+	else
+	  x /= 2;
+	++s;
+      }
+    c.steps = s + memo_steps[x];
+    c.peak = std::max (c.peak, u128 (memo_peak[x]));
+  }
+
+  /* Where a chain stands part way through: X after S steps.  */
+  struct cursor {
+    chain c;
+    u64 x;
+    unsigned s;
+  };
+
+  cursor start (u64 n) const
+  {
+    return {{n, 0, n}, n, 0};
+  }
+
+  /* The smallest H such that a jump from 2^k H + l might climb to
+     PEAK_FLOOR, for any l.  */
+  u64 h_floor (u128 peak_floor) const
+  {
+    if (peak_floor <= peak_add_max)
+      return 0;
+    const u128 h = (peak_floor - peak_add_max) / peak_mul_max;
+    return h > ~u64 (0) ? ~u64 (0) : u64 (h);
+  }
+
+  /* Take one jump along U's chain, or finish it off.  Returns false
+     when the chain is done.  Only work out the excursion exactly if it
+     might reach PEAK_FLOOR; otherwise the peak is just a lower bound.
+     H_FLOOR is h_floor (PEAK_FLOOR), which saves working out the bound
+     for most jumps.  */
+  bool advance (cursor &u, u128 peak_floor, u64 h_floor) const
+  {
+    chain &c = u.c;
+    if (u.x < memo_limit)
+      {
+	c.steps = u.s + memo_steps[u.x];
+	if (memo_peak_max > c.peak && memo_peak_max >= peak_floor)
+	  c.peak = std::max (c.peak, u128 (memo_peak[u.x]));
+	return false;
+      }
+    const jump &j = jumps[u.x & (jumps.size () - 1)];
+    const u64 h = u.x >> k;
+    if (h >= h_floor)
+      {
+	const u128 bound = u128 (j.peak_mul) * h + j.peak_add;
+	if (bound > c.peak && bound >= peak_floor)
+	  c.peak = std::max (c.peak, block_peak (u.x));
+      }
+    u64 y;
+    if (__builtin_mul_overflow (pow3[j.c], h, &y)
+	|| __builtin_add_overflow (y, u64 (j.d), &y))
+      {
+	slow (c, u.x, u.s);
+	return false;
+      }
+    u.x = y;
+    u.s += k + j.c;
+    return true;
+  }
+
+public:
+  /* Take JUMP_BITS steps at a time, and memoize everything below
+     2^MEMO_BITS.  A jump starting at 2^MEMO_BITS or above can't pass
+     through 1, so MEMO_BITS must exceed JUMP_BITS.  */
+  explicit collatz_engine (int memo_bits = 22, int jump_bits = 16)
+    : k (jump_bits), memo_limit (u64 (1) << memo_bits),
+      jumps (std::size_t (1) << jump_bits), memo_steps (memo_limit),
+      memo_peak (memo_limit)
+  {
+    assert (jump_bits >= 1 && jump_bits <= 16 && memo_bits > jump_bits
+	    && memo_bits <= 32);
+    pow3[0] = 1;
+    for (int i = 1; i <= 32; ++i)
+      pow3[i] = 3 * pow3[i - 1];
+
+    for (u64 l = 0; l < jumps.size (); ++l)
+      {
+	jump j = {};
+	u64 x = l;
+	for (int i = 0; i < k; ++i)
+	  if (x & 1)
+	    {
+	      j.peak_mul = std::max (j.peak_mul,
+				     std::uint32_t (3 * pow3[j.c] << (k - i)));
+	      j.peak_add = std::max (j.peak_add, std::uint32_t (3 * x + 1));
+	      x = (3 * x + 1) / 2;
+	      ++j.c;
+	    }
+	  else
+	    x /= 2;
+	j.d = x;
+	jumps[l] = j;
+	peak_mul_max = std::max (peak_mul_max, u64 (j.peak_mul));
+	peak_add_max = std::max (peak_add_max, u64 (j.peak_add));
+      }
+
+    /* Every value below V is done by the time we get to V, so walk
+       until we drop below V.  */
+    memo_steps[1] = 0;
+    memo_peak[1] = 1;
+    for (u64 v = 2; v < memo_limit; ++v)
+      {
+	u64 x = v, p = v;
+	unsigned s = 0;
+	while (x >= v)
+	  {
+	    if (x & 1)
+	      {
+		x = 3 * x + 1;
+		p = std::max (p, x);
+	      }
+	    else
+	      x /= 2;
+	    ++s;
+	  }
+	memo_steps[v] = s + memo_steps[x];
+	memo_peak[v] = std::max (p, memo_peak[x]);
+	memo_peak_max = std::max (memo_peak_max, memo_peak[v]);
+      }
+  }
+
+  /* The chain of N > 0, with its exact excursion.  */
+  chain walk (u64 n) const
+  {
+    cursor u = start (n);
+    while (advance (u, 0, 0))
+      ;
+    return u.c;
+  }
+
+  /* Scan [A, B] in chunks handed out to THREADS threads, each keeping
+     its own best, and combine them at the end.  */
+  scan_result scan (u64 a, u64 b,
+		    unsigned threads = std::thread::hardware_concurrency ())
+    const
+  {
+    assert (a > 0 && a <= b);
+    threads = std::max (threads, 1u);
+    constexpr u64 chunk = 1 << 16;
+    const u64 chunks = (b - a) / chunk + 1;
+    std::atomic<u64> next = 0;
+    std::vector<scan_result> best (threads);
+
+    auto work = [&] (scan_result &r) {
+      /* h_floor (r.highest.peak), redone only when that changes.  */
+      u64 hf = 0;
+      for (u64 i; (i = next++) < chunks; )
+	{
+	  const u64 lo = a + i * chunk;
+	  const u64 hi = std::min (b - lo, chunk - 1) + lo;
+	  for (u64 n = lo; ; ++n)
+	    {
+	      cursor u = start (n);
+	      while (advance (u, r.highest.peak, hf))
+		;
+	      const chain &c = u.c;
+	      if (c.steps > r.longest.steps
+		  || (c.steps == r.longest.steps && c.n < r.longest.n))
+		r.longest = c;
+	      if (c.peak > r.highest.peak
+		  || (c.peak == r.highest.peak && c.n < r.highest.n))
+		{
+		  r.highest = c;
+		  hf = h_floor (c.peak);
+		}
+	      if (n == hi)
+		break;
+	    }
+	}
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+      pool.emplace_back (work, std::ref (best[t]));
+    work (best[0]);
+    for (auto &t : pool)
+      t.join ();
+
+    scan_result r = best[0];
+    for (const scan_result &t : best)
+      {
+	if (t.longest.steps > r.longest.steps
+	    || (t.longest.steps == r.longest.steps && t.longest.n < r.longest.n))
+	  r.longest = t.longest;
+	if (t.highest.peak > r.highest.peak
+	    || (t.highest.peak == r.highest.peak && t.highest.n < r.highest.n))
+	  r.highest = t.highest;
+      }
+    /* The longest chain's peak may only be a lower bound.  */
+    r.longest = walk (r.longest.n);
+    return r;
+  }
+};
+
+static void
+print (const char *what, const chain &c)
+{
+  std::string s = what;
+  s += ": n == ";
+  append (s, c.n);
+  s += ", ";
+  append (s, c.steps);
+  s += " steps, peak ";
+  append (s, c.peak);
+  s += '\n';
+  std::fputs (s.c_str (), stdout);
 }
 
 int
-main ()
+main (int argc, char **argv)
 {
   collatz (7ul);
   collatz (12ul);
   collatz (27ul);
   collatz (871ul);
+
+  collatz_engine e;
+  for (u64 n = 1; n < 3000000; n += 997)
+    {
+      chain c = e.walk (n);
+      assert (c.steps == collatz (n, nullptr));
+    }
+  chain c = e.walk (77031);
+  assert (c.steps == 350 && c.peak == 21933016);
+  /* 2^64 is first exceeded here.  */
+  c = e.walk (12327829503);
+  assert (c.steps == collatz (12327829503, nullptr));
+  assert (c.peak == (u128 (1) << 64) + 2275654840695500112u);
+
+  scan_result r = e.scan (1, 1000000, 3);
+  assert (r.longest.n == 837799 && r.longest.steps == 524);
+  assert (r.highest.n == 704511 && r.highest.peak == 56991483520);
+  print ("longest", r.longest);
+  print ("highest", r.highest);
+
+  if (argc >= 3)
+    {
+      const u64 a = std::strtoull (argv[1], nullptr, 0);
+      const u64 b = std::strtoull (argv[2], nullptr, 0);
+      const unsigned threads = (argc > 3
+				? std::atoi (argv[3])
+				: std::thread::hardware_concurrency ());
+      r = e.scan (a, b, threads);
+      print ("longest", r.longest);
+      print ("highest", r.highest);
+    }
 }
@@ -0,0 +1,66 @@
+// Benchmarks for egcd.cc: extended_gcd, and modular inverses one at a
+// time, by Euclid or in binary, and in batches.  See bench.h for how to
+// build and run it.
+// Use -std=c++20 -O2.
+
+#include "bench.h"
+#include <string>
+
+/* Take the functions from egcd.cc, but not its main.  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main egcd_main
+#include "egcd.cc"
+#undef main
+#pragma GCC diagnostic pop
+
+int
+main (int argc, char **argv)
+{
+  bench_suite suite ("egcd", argc, argv);
+  bench_random rng;
+  constexpr std::size_t n = 10000;
+
+  /* Random pairs of BITS bits.  */
+  for (int bits : { 16, 32, 48, 63 })
+    {
+      std::vector<long> a (n), b (n);
+      for (std::size_t i = 0; i < n; ++i)
+	{
+	  a[i] = rng () >> (64 - bits);
+	  b[i] = rng () >> (64 - bits);
+	}
+      suite.run ("extended_gcd", bits, n, [&] {
+	for (std::size_t i = 0; i < n; ++i)
+	  do_not_optimize (extended_gcd (a[i], b[i]));
+      });
+    }
+
+  /* Inverses modulo the largest prime of BITS bits.  */
+  for (auto [bits, m] : { std::pair (31, 2147483647L),
+			  std::pair (63, 9223372036854775783L) })
+    {
+      std::vector<long> a (n);
+      for (auto &x : a)
+	x = 1 + rng.below (m - 1);
+      suite.run ("mult_inv_mod", bits, n, [&] {
+	for (std::size_t i = 0; i < n; ++i)
+	  do_not_optimize (mult_inv_mod (a[i], m));
+      });
+      suite.run ("mult_inv_mod_binary", bits, n, [&] {
+	for (std::size_t i = 0; i < n; ++i)
+	  do_not_optimize (mult_inv_mod_binary (a[i], m));
+      });
+
+      /* The batch replaces its input, so each call starts from a copy;
+	 the copy is timed too, but it's cheap next to the rest.  */
+      for (std::size_t k : sweep (1, n, 8))
+	{
+	  std::vector<long> v (k);
+	  suite.run ("mult_inv_mod_batch/" + std::to_string (bits), k, k, [&] {
+	    std::copy (a.begin (), a.begin () + k, v.begin ());
+	    do_not_optimize (mult_inv_mod_batch (std::span<long> (v), m));
+	  });
+	}
+    }
+}
@@ -0,0 +1,39 @@
+// Benchmarks for erat.cc: sift, the segmented count_primes, and
+// prime_count.  See bench.h for how to build and run it.
+// Use -std=c++20 -O2.
+
+#include "bench.h"
+
+/* Take the functions from erat.cc, but not its main.  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main erat_main
+#include "erat.cc"
+#undef main
+#pragma GCC diagnostic pop
+
+int
+main (int argc, char **argv)
+{
+  bench_suite suite ("erat", argc, argv);
+
+  /* An op is a number sifted or counted over.  */
+  for (std::uint64_t n : sweep (1000, 10000000))
+    {
+      std::vector<char> a (n);
+      suite.run ("sift", n, n, [&] {
+	sift (a.begin (), opaque (std::int64_t (n)));
+	do_not_optimize (a[0]);
+      });
+    }
+
+  for (std::uint64_t n : sweep (100000, 1000000000))
+    suite.run ("count_primes/1-thread", n, n, [&] {
+      do_not_optimize (count_primes (opaque (n), 1));
+    });
+
+  for (std::uint64_t n : sweep (1000000, 1000000000000, 100))
+    suite.run ("prime_count", n, 1, [&] {
+      do_not_optimize (prime_count (opaque (n)));
+    });
+}
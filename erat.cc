@@ -1,13 +1,23 @@
 // C++20 implementation of the Sieve of Eratosthenes.
 
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cmath>
 #include <concepts>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <iterator>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#define assert(X) do { if (!(X)) std::abort (); } while(0)
 
 // Mark all the nonprimes for a factor.
 template<std::random_access_iterator I, std::integral N>
-void mark_sieve (I first, I last, N factor)
+constexpr void mark_sieve (I first, I last, N factor)
 {
   *first = false;
   while (last - first > factor)
@@ -18,7 +28,7 @@ void mark_sieve (I first, I last, N factor)
 }
 
 template<std::random_access_iterator I, std::integral N>
-void sift (I first, N n)
+constexpr void sift (I first, N n)
 {
   I last = first + n;
   std::fill (first, last, true);
@@ -39,6 +49,373 @@ void sift (I first, N n)
     }
 }
 
+/* Compile-time tables.
+
+   sift is constexpr, so it can run over a std::array while the program
+   is being compiled, and the tables below end up in the binary as
+   constants: no work at startup, and no template recursion.  */
+
+/* sift of the odd numbers from 3 up to N.  */
+
+template<std::uint64_t N>
+  requires (N >= 3)
+constexpr auto sifted = [] {
+  std::array<bool, (N - 3) / 2 + 1> a{};
+  sift (a.begin (), std::int64_t (a.size ()));
+  return a;
+} ();
+
+/* The number of primes up to N.  */
+
+template<std::uint64_t N>
+constexpr std::size_t prime_count_v = [] {
+  if constexpr (N < 3)
+    return std::size_t (N == 2);
+  else
+    {
+      std::size_t c = 1;
+      for (bool b : sifted<N>)
+	c += b;
+      return c;
+    }
+} ();
+
+/* All the primes up to N, in increasing order.  */
+
+template<std::uint64_t N, std::unsigned_integral T = std::uint32_t>
+constexpr auto prime_table = [] {
+  std::array<T, prime_count_v<N>> t{};
+  if constexpr (N >= 2)
+    t[0] = 2;
+  if constexpr (N >= 3)
+    {
+      std::size_t k = 1;
+      T v = 3;
+      for (bool b : sifted<N>)
+	{
+	  if (b)
+	    t[k++] = v;
+	  v += 2;
+	}
+    }
+  return t;
+} ();
+
+/* The product of the first K primes.  */
+
+template<std::size_t K>
+constexpr std::uint64_t primorial = [] {
+  std::uint64_t m = 1;
+  for (std::size_t i = 0; i < K; ++i)
+    m *= prime_table<32>[i];
+  return m;
+} ();
+
+/* The residues modulo primorial<K> that are coprime to it, i.e. the
+   numbers not divisible by any of the first K primes lie in these
+   residue classes.  For K = 3 that's the 8 classes mod 30.  */
+
+template<std::size_t K, std::unsigned_integral T = std::uint32_t>
+  requires (K >= 1 && K <= 6)
+constexpr auto coprime_residues = [] {
+  constexpr std::uint64_t m = primorial<K>;
+  auto coprime = [] (std::uint64_t r) {
+    for (std::size_t i = 0; i < K; ++i)
+      if (r % prime_table<32>[i] == 0)
+	return false;
+    return true;
+  };
+  constexpr std::size_t count = [] {
+    std::size_t c = 1;
+    for (std::size_t i = 0; i < K; ++i)
+      c *= prime_table<32>[i] - 1;
+    return c;
+  } ();
+  std::array<T, count> t{};
+  std::size_t k = 0;
+  for (std::uint64_t r = 1; r < m; ++r)
+    if (coprime (r))
+      t[k++] = r;
+  return t;
+} ();
+
+static_assert (prime_count_v<2> == 1);
+static_assert (prime_count_v<100> == 25);
+static_assert (prime_table<100>.back () == 97);
+static_assert (coprime_residues<3>.size () == 8);
+static_assert (coprime_residues<3>[1] == 7);
+
+/* Segmented sieve.
+
+   sift keeps a bool for every odd number in the range, so its memory
+   grows with N, and once the array no longer fits in cache every pass
+   of mark_sieve goes out to RAM.  Here we keep the same odd-only
+   numbering (index i stands for 2i + 3), but store one bit per index and
+   sieve the range one segment at a time, with the segment small enough
+   to stay in cache.  Only the primes up to sqrt(N) are kept around.
+
+   Multiples of 2 are never stored; multiples of 3, 5 and 7 are removed
+   by copying a precomputed pattern into each segment (the wheel), so
+   mark_sieve-style crossing off starts at 11.  */
+
+/* Segment size in bytes; should fit in L1 or L2.  */
+constexpr std::size_t segment_bytes = 32 * 1024;
+constexpr std::uint64_t segment_bits = segment_bytes * 8;
+
+/* Value at index I, and index of the odd value V.  */
+constexpr std::uint64_t value_at (std::uint64_t i) { return 2 * i + 3; }
+constexpr std::uint64_t index_of (std::uint64_t v) { return (v - 3) / 2; }
+
+/* The pattern of multiples of 3, 5 and 7 repeats every 105 indices, and
+   so every 105 words.  */
+constexpr std::size_t wheel_words = 3 * 5 * 7;
+
+constexpr auto wheel_pattern = [] {
+  std::array<std::uint64_t, wheel_words> w{};
+  for (std::uint64_t i = 0; i < wheel_words * 64; ++i)
+    {
+      std::uint64_t v = value_at (i);
+      if (v % 3 != 0 && v % 5 != 0 && v % 7 != 0)
+	w[i / 64] |= std::uint64_t (1) << (i % 64);
+    }
+  return w;
+} ();
+
+/* Return floor (sqrt (N)).  */
+
+static std::uint64_t
+isqrt (std::uint64_t n)
+{
+  std::uint64_t r = std::sqrt (double (n));
+  while (r * r > n)
+    --r;
+  while ((r + 1) * (r + 1) <= n)
+    ++r;
+  return r;
+}
+
+/* Odd primes from 11 up to sqrt (N).  For N < 2^32 they come from a
+   table built at compile time, otherwise they're found with sift.  */
+
+static std::vector<std::uint64_t>
+sieving_primes (std::uint64_t n)
+{
+  static constexpr auto &small = prime_table<65535>;
+  std::uint64_t root = isqrt (n);
+  std::vector<std::uint64_t> primes;
+  if (root < 11)
+    return primes;
+  if (root <= 65535)
+    {
+      auto first = std::ranges::lower_bound (small, 11);
+      auto last = std::ranges::upper_bound (small, root);
+      primes.assign (first, last);
+      return primes;
+    }
+  std::int64_t sz = index_of (root) + 1;
+  std::vector<char> a (sz);
+  sift (a.begin (), sz);
+  for (std::int64_t i = index_of (11); i < sz; ++i)
+    if (a[i])
+      primes.push_back (value_at (i));
+  return primes;
+}
+
+/* Sieve segments [FIRST, LAST) of the odd numbers up to N, one at a time,
+   and call F (LO, WORDS, NBITS) for each of them.  Bit j of WORDS is set
+   iff the value at index LO + j is prime.  PRIMES are the sieving primes
+   for N.  */
+
+template<typename F>
+void sieve_segments (std::uint64_t first, std::uint64_t last, std::uint64_t n,
+		     const std::vector<std::uint64_t> &primes, F f)
+{
+  const std::uint64_t nindices = index_of (n) + 1;
+  std::vector<std::uint64_t> words (segment_bits / 64);
+
+  /* Next index to cross off for each prime.  */
+  std::vector<std::uint64_t> next (primes.size ());
+  const std::uint64_t start = first * segment_bits;
+  for (std::size_t k = 0; k < primes.size (); ++k)
+    {
+      std::uint64_t p = primes[k];
+      std::uint64_t j = index_of (p * p);
+      if (j < start)
+	j = start + (p - (start - j) % p) % p;
+      next[k] = j;
+    }
+
+  for (std::uint64_t seg = first; seg < last; ++seg)
+    {
+      const std::uint64_t lo = seg * segment_bits;
+      const std::uint64_t hi = std::min (lo + segment_bits, nindices);
+      const std::uint64_t nbits = hi - lo;
+      const std::size_t nwords = (nbits + 63) / 64;
+
+      /* Lay down the wheel.  */
+      std::size_t w = (lo / 64) % wheel_words;
+      for (std::size_t i = 0; i < nwords; ++i)
+	{
+	  words[i] = wheel_pattern[w];
+	  if (++w == wheel_words)
+	    w = 0;
+	}
+      /* The pattern crossed off 3, 5 and 7 themselves.  */
+      if (lo == 0)
+	words[0] |= 7;
+
+      for (std::size_t k = 0; k < primes.size (); ++k)
+	{
+	  std::uint64_t p = primes[k];
+	  std::uint64_t j = next[k];
+	  for (; j < hi; j += p)
+	    words[(j - lo) / 64] &= ~(std::uint64_t (1) << ((j - lo) % 64));
+	  next[k] = j;
+	}
+
+      /* Drop the indices past N.  */
+      if (nbits % 64)
+	words[nwords - 1] &= (std::uint64_t (1) << (nbits % 64)) - 1;
+
+      f (lo, words.data (), nbits);
+    }
+}
+
+/* Return the number of primes <= N.  The segments are split into THREADS
+   contiguous runs, each sieved by its own thread.  */
+
+static std::uint64_t
+count_primes (std::uint64_t n,
+	      unsigned threads = std::max (1u,
+					   std::thread::hardware_concurrency ()))
+{
+  if (n < 3)
+    return n == 2;
+
+  const auto primes = sieving_primes (n);
+  const std::uint64_t nsegs = (index_of (n) + segment_bits) / segment_bits;
+  threads = std::min<std::uint64_t> (threads, nsegs);
+
+  std::vector<std::uint64_t> counts (threads);
+  auto work = [&] (unsigned t) {
+    std::uint64_t c = 0;
+    sieve_segments (nsegs * t / threads, nsegs * (t + 1) / threads, n, primes,
+		    [&] (std::uint64_t, const std::uint64_t *words,
+			 std::uint64_t nbits) {
+		      for (std::size_t i = 0; i < (nbits + 63) / 64; ++i)
+			c += std::popcount (words[i]);
+		    });
+    counts[t] = c;
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+    pool.emplace_back (work, t);
+  work (0);
+  for (auto &th : pool)
+    th.join ();
+
+  /* Plus 2.  */
+  std::uint64_t total = 1;
+  for (auto c : counts)
+    total += c;
+  return total;
+}
+
+/* Call F (P) for every prime P <= N, in increasing order.  */
+
+template<typename F>
+void for_each_prime (std::uint64_t n, F f)
+{
+  if (n < 2)
+    return;
+  f (std::uint64_t (2));
+  if (n < 3)
+    return;
+  const std::uint64_t nsegs = (index_of (n) + segment_bits) / segment_bits;
+  sieve_segments (0, nsegs, n, sieving_primes (n),
+		  [&] (std::uint64_t lo, const std::uint64_t *words,
+		       std::uint64_t nbits) {
+		    for (std::size_t i = 0; i < (nbits + 63) / 64; ++i)
+		      for (std::uint64_t w = words[i]; w; w &= w - 1)
+			f (value_at (lo + i * 64 + std::countr_zero (w)));
+		  });
+}
+
+/* Return pi(X), the number of primes <= X, without looking at every
+   number up to X (Lucy_Hedgehog's method, a Legendre-style sieve).
+
+   Let S(v, p) be the count of the numbers in [2, v] that are either
+   prime or have no prime factor <= p.  Going from p - 1 to a prime p
+   removes the numbers whose smallest prime factor is p:
+
+     S(v, p) = S(v, p - 1) - (S(v / p, p - 1) - S(p - 1, p - 1))
+
+   and pi(x) = S(x, sqrt (x)).  Only v of the form x / i occur, and
+   there are about 2 sqrt (x) of those, so this needs O(sqrt (x)) memory
+   and O(x^{3/4}) time.  The primes up to sqrt (x) are taken from sift.  */
+
+static std::uint64_t
+prime_count (std::uint64_t x)
+{
+  if (x < 2)
+    return 0;
+
+  const std::uint64_t r = isqrt (x);
+  /* lo[v] = S(v), for v <= r.  hi[i] = S(x / i), for i <= r.  */
+  std::vector<std::uint32_t> lo (r + 1);
+  std::vector<std::uint64_t> hi (r + 1);
+  /* x / i, cached.  */
+  std::vector<std::uint64_t> xdiv (r + 1);
+  for (std::uint64_t v = 1; v <= r; ++v)
+    {
+      lo[v] = v - 1;
+      xdiv[v] = x / v;
+      hi[v] = xdiv[v] - 1;
+    }
+
+  auto sieve_with = [&] (std::uint64_t p) {
+    const std::uint64_t sp = lo[p - 1];
+    const std::uint64_t p2 = p * p;
+    /* floor (x / i / p) through a double reciprocal, fixed up; the error
+       is at most one either way while x / i < 2^53.  */
+    const double inv = 1.0 / p;
+    const std::uint64_t lim = std::min (r, x / p2);
+    for (std::uint64_t i = 1; i <= lim; ++i)
+      {
+	std::uint64_t d = i * p;
+	std::uint64_t s;
+	if (d <= r)
+	  s = hi[d];
+	else
+	  {
+	    std::uint64_t q = xdiv[i] * inv;
+	    if (q * p > xdiv[i])
+	      --q;
+	    else if ((q + 1) * p <= xdiv[i])
+	      ++q;
+	    s = lo[q];
+	  }
+	hi[i] -= s - sp;
+      }
+    for (std::uint64_t v = r; v >= p2; --v)
+      lo[v] -= lo[std::uint32_t (v) / std::uint32_t (p)] - sp;
+  };
+
+  sieve_with (2);
+  if (r >= 3)
+    {
+      std::int64_t sz = index_of (r) + 1;
+      std::vector<char> a (sz);
+      sift (a.begin (), sz);
+      for (std::int64_t i = 0; i < sz; ++i)
+	if (a[i])
+	  sieve_with (value_at (i));
+    }
+
+  return hi[1];
+}
+
 int
 main ()
 {
@@ -49,4 +426,44 @@ main ()
   for (int i = 0; i < sz; ++i)
     if (a[i])
       std::cout << 2 * i + 3 << "\n";
+
+  /* The segmented sieve agrees with sift.  */
+  constexpr int big = 1000000;
+  std::vector<char> b (big);
+  sift (b.begin (), big);
+  std::vector<std::uint64_t> ps;
+  for_each_prime (value_at (big - 1), [&] (std::uint64_t p) {
+    ps.push_back (p);
+  });
+  assert (ps[0] == 2);
+  std::size_t k = 1;
+  for (int i = 0; i < big; ++i)
+    if (b[i])
+      assert (ps[k++] == value_at (i));
+  assert (k == ps.size ());
+
+  assert (count_primes (0) == 0);
+  assert (count_primes (2) == 1);
+  assert (count_primes (10) == 4);
+  assert (count_primes (100) == 25);
+  assert (count_primes (10000000) == 664579);
+  assert (count_primes (1000000000, 4) == 50847534);
+
+  /* pi(x) without sieving up to x.  */
+  for (std::uint64_t x = 0; x < 1000; ++x)
+    assert (prime_count (x) == count_primes (x));
+  assert (prime_count (1000000007) == count_primes (1000000007));
+  assert (prime_count (10000000000) == 455052511);
+  assert (prime_count (1000000000000) == 37607912018);
+
+  /* The compile-time tables agree with the sieves.  */
+  static_assert (prime_count_v<65535> == 6542);
+  assert (count_primes (65535) == prime_count_v<65535>);
+  std::size_t j = 0;
+  for_each_prime (65535, [&] (std::uint64_t p) {
+    assert (prime_table<65535>[j++] == p);
+  });
+  for (std::uint32_t r : coprime_residues<4>)
+    assert (std::gcd (r, 210u) == 1);
+  static_assert (coprime_residues<4>.size () == 48);
 }
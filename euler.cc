@@ -1,7 +1,10 @@
 // Euler’s Totient Function
+// Use -std=c++20.
 
+#include <concepts>
 #include <cstdlib>
 #include <utility>
+#include <vector>
 
 #define assert(X) do { if (!(X)) std::abort (); } while(0)
 
@@ -50,46 +53,131 @@ static constexpr std::pair<int, int> res[] = {
   { 143, 120 },
 };
 
-/* True iff N is prime.  */
+/* Linear (Euler) sieve.  Returns a table SPF where SPF[i] is the smallest
+   prime factor of i, for 2 <= i <= N.  Every composite i * p is crossed
+   off exactly once, by its smallest prime factor p, so this is O(N).  */
 
-static bool
-prime_p (int n)
+template<std::integral I>
+std::vector<I> smallest_prime_factors (I n)
 {
-  if (n <= 3)
-    return n > 1;
-  else if ((n % 2) == 0 || (n % 3) == 0)
-    return false;
-  int i = 5;
-  while (i * i <= n)
+  std::vector<I> spf (n + 1);
+  std::vector<I> primes;
+  for (I i = 2; i <= n; ++i)
     {
-      if ((n % i) == 0 || n % (i + 2) == 0)
-	return false;
-      i += 6;
+      if (spf[i] == 0)
+	{
+	  spf[i] = i;
+	  primes.push_back (i);
+	}
+      for (I p : primes)
+	{
+	  if (p > spf[i] || p > n / i)
+	    break;
+	  spf[i * p] = p;
+	}
     }
-  return true;
+  return spf;
 }
 
-/* https://en.wikipedia.org/wiki/Euler%27s_totient_function */
+/* https://en.wikipedia.org/wiki/Euler%27s_totient_function
+
+     phi(n) = n * prod (1 - 1/p) over the primes p dividing n
+
+   SPF is a table from smallest_prime_factors that covers N.  Factoring N
+   with it takes O(log n) steps, and r -= r / p keeps everything exact.  */
+
+template<std::integral I>
+I phi (I n, const std::vector<I> &spf)
+{
+  I r = n;
+  while (n > 1)
+    {
+      I p = spf[n];
+      r -= r / p;
+      do
+	n /= p;
+      while (n % p == 0);
+    }
+  return r;
+}
+
+/* Same, without a table: factor N by trial division.  */
 
 static int
 phi (int n)
 {
-  if (prime_p (n))
-    return n - 1;
+  int r = n;
+  for (int p = 2; p <= n / p; ++p)
+    if (n % p == 0)
+      {
+	r -= r / p;
+	do
+	  n /= p;
+	while (n % p == 0);
+      }
+  if (n > 1)
+    r -= r / n;
+  return r;
+}
 
-  double r = 1.0;
-  for (int p = 2; p < n; ++p)
-    if (prime_p (p) && n % p == 0)
-      r *= 1 - 1 / double(p);
+/* phi(i) for every 0 <= i <= N, in one pass of the linear sieve:
 
-  return n * r;
+     phi(i * p) = phi(i) * p        if p divides i
+     phi(i * p) = phi(i) * (p - 1)  otherwise  */
+
+template<std::integral I>
+std::vector<I> phi_table (I n)
+{
+  std::vector<I> t (n + 1);
+  std::vector<I> primes;
+  if (n >= 1)
+    t[1] = 1;
+  for (I i = 2; i <= n; ++i)
+    {
+      if (t[i] == 0)
+	{
+	  t[i] = i - 1;
+	  primes.push_back (i);
+	}
+      for (I p : primes)
+	{
+	  if (p > n / i)
+	    break;
+	  if (i % p == 0)
+	    {
+	      t[i * p] = t[i] * p;
+	      break;
+	    }
+	  t[i * p] = t[i] * (p - 1);
+	}
+    }
+  return t;
 }
 
 static void
 do_test ()
 {
+  const auto spf = smallest_prime_factors (143);
+  const auto t = phi_table (143);
   for (const auto &x : res)
-    assert (phi (x.first) == x.second);
+    {
+      assert (phi (x.first) == x.second);
+      assert (phi (x.first, spf) == x.second);
+      assert (t[x.first] == x.second);
+    }
+
+  constexpr long n = 1000000;
+  const auto spf2 = smallest_prime_factors (n);
+  const auto t2 = phi_table (n);
+  long sum = 0;
+  for (long i = 1; i <= n; ++i)
+    {
+      assert (phi (i, spf2) == t2[i]);
+      sum += t2[i];
+    }
+  assert (sum == 303963552392);
+  assert (phi (999983) == 999982);
+  assert (phi (1 << 30) == 1 << 29);
 }
 
 int
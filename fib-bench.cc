@@ -0,0 +1,53 @@
+// Benchmarks for fib.cc: fast doubling in machine words and in natural,
+// against one addition at a time, and Fibonacci numbers modulo M.  See
+// bench.h for how to build and run it.
+// Use -std=c++20 -O2.
+
+#include "bench.h"
+
+/* Take the functions from fib.cc, but not its main.  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main fib_main
+#include "fib.cc"
+#undef main
+#pragma GCC diagnostic pop
+
+int
+main (int argc, char **argv)
+{
+  bench_suite suite ("fib", argc, argv);
+
+  for (std::uint64_t n : { 10, 30, 60, 90 })
+    {
+      suite.run ("fib_linear", n, 1, [&] {
+	do_not_optimize (fib_linear (opaque (n)));
+      });
+      suite.run ("fib<uint64_t>", n, 1, [&] {
+	do_not_optimize (fib<std::uint64_t> (opaque (n)));
+      });
+    }
+  for (std::uint64_t n : { 120, 150, 180 })
+    suite.run ("fib<unsigned __int128>", n, 1, [&] {
+      do_not_optimize (fib<unsigned __int128> (opaque (n)));
+    });
+  for (std::uint64_t n : sweep (1000, 1000000))
+    suite.run ("fib<natural>", n, 1, [&] {
+      do_not_optimize (fib<natural> (opaque (n)));
+    });
+
+  /* A prime modulus, where N gets reduced by the Pisano period once
+     it's past M, and odd and even ones, where it doesn't.  */
+  for (std::uint64_t n : sweep (1000, 1000000000000000000, 1000))
+    {
+      suite.run ("fib_mod/prime", n, 1, [&] {
+	do_not_optimize (fib_mod (opaque (n), 1000000007));
+      });
+      suite.run ("fib_mod/odd", n, 1, [&] {
+	do_not_optimize (fib_mod (opaque (n), 12157665459056928801u));
+      });
+      suite.run ("fib_mod/even", n, 1, [&] {
+	do_not_optimize (fib_mod (opaque (n), 10000000000));
+      });
+    }
+}
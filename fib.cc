@@ -1,24 +1,190 @@
 // Fibonacci Number.
-// This is O(n).
+// By fast doubling, this is O(log n) multiplications.
+// Use -std=c++20.
 
+#include "miller-rabin.h"
+#include "montgomery.h"
+#include "natural.h"
+#include <bit>
+#include <cstdint>
+#include <iostream>
 #include <utility>
 
-int
-fib (int n)
+#define assert(X) do { if (!(X)) std::abort (); } while(0)
+
+/* Compute F(N), the old way: one addition at a time.  */
+
+static std::uint64_t
+fib_linear (unsigned n)
 {
   if (n == 0)
     return 0;
-  std::pair<int, int> v = {0, 1};
-  for (int i = 1; i < n; ++i)
+  std::pair<std::uint64_t, std::uint64_t> v = {0, 1};
+  for (unsigned i = 1; i < n; ++i)
     v = {v.second, v.first + v.second};
   return v.second;
 }
 
+/* Compute F(N) in the number type T: an unsigned integer type, where
+   the result is exact up to F(93) in 64 bits and F(186) in 128 bits and
+   wraps around beyond that, or natural, for an exact F(N) of any size.
+
+   Going from F(k) and F(k - 1) to F(2k) and F(2k -/+ 1) needs just two
+   squarings:
+
+     F(2k + 1) = 4 F(k)^2 - F(k - 1)^2 + 2 (-1)^k
+     F(2k - 1) = F(k)^2 + F(k - 1)^2
+     F(2k)     = F(2k + 1) - F(2k - 1)
+
+   and so the bits of N, from the top, take us from F(1) to F(N).  In an
+   unsigned integer type this is all exact modulo 2^bits, so wrapping
+   around on the way doesn't matter; in natural, no intermediate value
+   is ever negative.  */
+
+template<typename T>
+T fib (std::uint64_t n)
+{
+  if (n == 0)
+    return T (0);
+  T a (1), b (0);	// F(k), F(k - 1), starting with k = 1
+  bool odd_k = true;
+  for (int i = std::bit_width (n) - 2; i >= 0; --i)
+    {
+      const T a2 = a * a;
+      const T b2 = b * b;
+      T f2k1 = (a2 << 2) - b2;
+      if (odd_k)
+	f2k1 = f2k1 - T (2);
+      else
+	f2k1 = f2k1 + T (2);
+      T f2km1 = a2 + b2;
+      T f2k = f2k1 - f2km1;
+      odd_k = (n >> i) & 1;
+      if (odd_k)
+	{
+	  a = std::move (f2k1);
+	  b = std::move (f2k);
+	}
+      else
+	{
+	  a = std::move (f2k);
+	  b = std::move (f2km1);
+	}
+    }
+  return a;
+}
+
+/* A multiple of the Pisano period of the prime P, the period of the
+   Fibonacci numbers modulo P.  For P = +/-1 mod 5, 5 is a square
+   modulo P, the roots of x^2 - x - 1 live in GF(P), and the period
+   divides P - 1.  Otherwise they live in GF(P^2) with norm -1, and
+   the period divides 2 (P + 1).  */
+
+static unsigned __int128
+pisano_multiple (std::uint64_t p)
+{
+  if (p == 2)
+    return 3;
+  if (p == 5)
+    return 20;
+  if (p % 5 == 1 || p % 5 == 4)
+    return p - 1;
+  return 2 * (unsigned __int128) (p + 1);
+}
+
+/* Fast doubling from F(0) and F(1) to F(N), with MUL multiplying, and
+   ONE being 1, in the representation of the residues modulo M.  Uses
+
+     F(2k)     = F(k) (2 F(k + 1) - F(k))
+     F(2k + 1) = F(k)^2 + F(k + 1)^2.  */
+
+template<typename Mul>
+static std::uint64_t
+fib_doubling (std::uint64_t n, std::uint64_t m, std::uint64_t one, Mul mul)
+{
+  auto add = [m] (std::uint64_t x, std::uint64_t y) {
+    return x >= m - y ? x - (m - y) : x + y;
+  };
+  auto sub = [m] (std::uint64_t x, std::uint64_t y) {
+    return x >= y ? x - y : x + (m - y);
+  };
+  std::uint64_t a = 0, b = one;	// F(k), F(k + 1), starting with k = 0
+  for (int i = std::bit_width (n) - 1; i >= 0; --i)
+    {
+      const std::uint64_t c = mul (a, sub (add (b, b), a));
+      const std::uint64_t d = add (mul (a, a), mul (b, b));
+      if ((n >> i) & 1)
+	{
+	  a = d;
+	  b = add (c, d);
+	}
+      else
+	{
+	  a = c;
+	  b = d;
+	}
+    }
+  return a;
+}
+
+/* Compute F(N) mod M.  If M is prime and smaller than N, N is first
+   reduced modulo a multiple of the Pisano period; that's worth the
+   primality test only then.  Odd moduli are done in Montgomery form,
+   even ones with a 128-bit product.  */
+
+static std::uint64_t
+fib_mod (std::uint64_t n, std::uint64_t m)
+{
+  if (m == 1)
+    return 0;
+  if (n >= m && prime_p (m))
+    n = n % pisano_multiple (m);
+  if (odd (m))
+    {
+      const montgomery mont (m);
+      return mont.from (fib_doubling (n, m, mont.one (), mont));
+    }
+  return fib_doubling (n, m, 1, [m] (std::uint64_t x, std::uint64_t y) {
+    return mul_mod (x, y, m);
+  });
+}
+
 int
 main ()
 {
-  __builtin_printf ("fib (%d) = %d\n", 6, fib (6));
-  __builtin_printf ("fib (%d) = %d\n", 7, fib (7));
-  __builtin_printf ("fib (%d) = %d\n", 8, fib (8));
-  __builtin_printf ("fib (%d) = %d\n", 9, fib (9));
+  __builtin_printf ("fib (%d) = %lu\n", 6, fib<std::uint64_t> (6));
+  __builtin_printf ("fib (%d) = %lu\n", 7, fib<std::uint64_t> (7));
+  __builtin_printf ("fib (%d) = %lu\n", 8, fib<std::uint64_t> (8));
+  __builtin_printf ("fib (%d) = %lu\n", 9, fib<std::uint64_t> (9));
+
+  for (unsigned n = 0; n <= 93; ++n)
+    {
+      assert (fib<std::uint64_t> (n) == fib_linear (n));
+      assert (fib<unsigned __int128> (n) == fib_linear (n));
+      assert (fib<natural> (n) == natural (fib_linear (n)));
+      assert (fib_mod (n, 1000000007) == fib_linear (n) % 1000000007);
+      assert (fib_mod (n, 1u << 20) == fib_linear (n) % (1u << 20));
+    }
+  /* F(186) is the last one to fit in 128 bits.  */
+  unsigned __int128 f = fib<unsigned __int128> (186);
+  assert (std::uint64_t (f >> 64) == 18042485370706291343u
+	  && std::uint64_t (f) == 14458561666841997560u);
+  assert (natural (std::vector<limb>{ limb (f), limb (f >> 64) })
+	  == fib<natural> (186));
+
+  /* Far out of reach of the loop.  */
+  constexpr std::uint64_t big = 1000000000000000000;
+  assert (fib_mod (big, 1000000007) == 209783453);
+  assert (fib_mod (big, 4611686018427387847) == 574325699625031645);
+  assert (fib_mod (big, 10000000000) == 9560546875);
+  /* The Pisano period of 10^9 + 7 divides 2 (10^9 + 8).  */
+  assert (fib_mod (2000000016, 1000000007) == 0);
+  assert (fib_mod (2000000017, 1000000007) == 1);
+
+  /* Exact big values agree with the modular ones.  */
+  const natural f1m = fib<natural> (1000000);
+  assert (bit_width (f1m) == 694241);
+  const std::uint64_t p = 4611686018427387847;
+  assert ((f1m % natural (p)).low () == fib_mod (1000000, p));
+  std::cout << "fib (1000000) has " << bit_width (f1m) << " bits\n";
 }
@@ -0,0 +1,136 @@
+// Benchmarks for gcm.cc: stein_gcd, Euclid's gcd and std::gcd on words
+// (uniform, Fibonacci and smooth inputs), and Lehmer's and the binary GCD
+// on wide_uint.  See bench.h for how to build and run it.
+// Use -std=c++20 -O2.
+
+#include "bench.h"
+
+/* Take the functions from gcm.cc, but not its main.  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main gcm_main
+#include "gcm.cc"
+#undef main
+#pragma GCC diagnostic pop
+
+/* Time F on every pair in IN.  */
+
+template<typename T, typename F>
+static void
+bench_pairs (bench_suite &suite, const std::string &name, std::uint64_t size,
+	     const std::vector<std::pair<T, T>> &in, F f)
+{
+  suite.run (name, size, in.size (), [&] {
+    for (const auto &[a, b] : in)
+      do_not_optimize (f (a, b));
+  });
+}
+
+int
+main (int argc, char **argv)
+{
+  using u64 = std::uint64_t;
+  using u128 = unsigned __int128;
+  bench_suite suite ("gcm", argc, argv);
+  bench_random rng;
+  constexpr int n = 10000;
+
+  /* Uniform inputs of BITS bits.  */
+  for (int bits : { 8, 16, 32, 48, 64 })
+    {
+      std::vector<std::pair<u64, u64>> in;
+      for (int i = 0; i < n; ++i)
+	in.emplace_back (rng () >> (64 - bits), rng () >> (64 - bits));
+      bench_pairs (suite, "stein_gcd/u64", bits, in,
+		   [] (u64 a, u64 b) { return stein_gcd (a, b); });
+      bench_pairs (suite, "gcd/u64", bits, in,
+		   [] (u64 a, u64 b) { return gcd (a, b); });
+      bench_pairs (suite, "std::gcd/u64", bits, in,
+		   [] (u64 a, u64 b) { return std::gcd (a, b); });
+    }
+
+  /* Consecutive Fibonacci numbers, Euclid's worst case, of about BITS
+     bits.  */
+  u64 fib[94] = { 0, 1 };
+  for (int i = 2; i < 94; ++i)
+    fib[i] = fib[i - 1] + fib[i - 2];
+  for (int k : { 23, 46, 69, 92 })
+    {
+      std::vector<std::pair<u64, u64>> in (n, { fib[k + 1], fib[k] });
+      const int bits = std::bit_width (fib[k + 1]);
+      bench_pairs (suite, "stein_gcd/fibonacci", bits, in,
+		   [] (u64 a, u64 b) { return stein_gcd (opaque (a), b); });
+      bench_pairs (suite, "gcd/fibonacci", bits, in,
+		   [] (u64 a, u64 b) { return gcd (opaque (a), b); });
+    }
+
+  /* Pairs drawn from the 60th to the 92nd, so that the length of the
+     loop varies too.  */
+  {
+    std::vector<std::pair<u64, u64>> in;
+    for (int i = 0; i < n; ++i)
+      {
+	const int k = 60 + rng.below (33);
+	in.emplace_back (fib[k + 1], fib[k]);
+      }
+    bench_pairs (suite, "stein_gcd/fibonacci-mixed", 64, in,
+		 [] (u64 a, u64 b) { return stein_gcd (a, b); });
+    bench_pairs (suite, "gcd/fibonacci-mixed", 64, in,
+		 [] (u64 a, u64 b) { return gcd (a, b); });
+    bench_pairs (suite, "std::gcd/fibonacci-mixed", 64, in,
+		 [] (u64 a, u64 b) { return std::gcd (a, b); });
+  }
+
+  /* Products of the primes up to 13, as big as fit in 64 bits, with
+     lots of factors in common.  */
+  {
+    constexpr u64 small[] = { 2, 3, 5, 7, 11, 13 };
+    auto smooth = [&] {
+      u64 x = 1;
+      for (;;)
+	{
+	  const u64 p = small[rng.below (6)];
+	  if (x > ~u64 (0) / p)
+	    return x;
+	  x *= p;
+	}
+    };
+    std::vector<std::pair<u64, u64>> in;
+    for (int i = 0; i < n; ++i)
+      in.emplace_back (smooth (), smooth ());
+    bench_pairs (suite, "stein_gcd/smooth", 64, in,
+		 [] (u64 a, u64 b) { return stein_gcd (a, b); });
+    bench_pairs (suite, "gcd/smooth", 64, in,
+		 [] (u64 a, u64 b) { return gcd (a, b); });
+    bench_pairs (suite, "std::gcd/smooth", 64, in,
+		 [] (u64 a, u64 b) { return std::gcd (a, b); });
+  }
+
+  for (int bits : { 80, 96, 128 })
+    {
+      std::vector<std::pair<u128, u128>> in;
+      for (int i = 0; i < n; ++i)
+	in.emplace_back ((u128 (rng ()) << 64 | rng ()) >> (128 - bits),
+			 (u128 (rng ()) << 64 | rng ()) >> (128 - bits));
+      bench_pairs (suite, "stein_gcd/u128", bits, in,
+		   [] (u128 a, u128 b) { return stein_gcd (a, b); });
+      bench_pairs (suite, "gcd/u128", bits, in,
+		   [] (u128 a, u128 b) { return gcd (a, b); });
+    }
+
+  auto bench_wide = [&]<std::size_t Bits> () {
+    using big = wide_uint<Bits>;
+    std::vector<std::pair<big, big>> in;
+    for (int i = 0; i < 100; ++i)
+      in.emplace_back (random_wide_uint<Bits> (Bits),
+		       random_wide_uint<Bits> (Bits - Bits / 32));
+    bench_pairs (suite, "lehmer_gcd", Bits, in,
+		 [] (const big &a, const big &b) { return lehmer_gcd (a, b); });
+    bench_pairs (suite, "binary_gcd", Bits, in,
+		 [] (const big &a, const big &b) { return binary_gcd (a, b); });
+  };
+  bench_wide.operator()<256> ();
+  bench_wide.operator()<512> ();
+  bench_wide.operator()<1024> ();
+  bench_wide.operator()<2048> ();
+}
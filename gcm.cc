@@ -1,6 +1,16 @@
+// Greatest common divisors.
+// Use -std=c++20.  gcm-bench.cc times them.
+
 #include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#include "bigint.h"
 
 // Recursive Remainder Lemma:
 // If r = segment_remainder (a, 2b), then
@@ -34,8 +44,9 @@ gcm (size_t a, size_t b)
 }
 
 // If we can use %.
-int
-gcd (int a, int b)
+template<typename N>
+N
+gcd (N a, N b)
 {
   while (b != 0)
     {
@@ -55,6 +66,39 @@ bool even (N n)
   return !(n & 1);
 }
 
+// The number of trailing zero bits of N != 0.  One instruction for the
+// built-in types, including __int128.
+
+template<BinaryInteger N>
+int ctz (N n)
+{
+  if constexpr (std::is_class_v<N>)
+    {
+      int k = 0;
+      while (even (n))
+	{
+	  n >>= 1;
+	  ++k;
+	}
+      return k;
+    }
+  else if constexpr (sizeof (N) <= sizeof (unsigned))
+    return __builtin_ctz (n);
+  else if constexpr (sizeof (N) <= sizeof (unsigned long long))
+    return __builtin_ctzll (n);
+  else
+    {
+      const unsigned long long lo = n;
+      return (lo ? __builtin_ctzll (lo)
+	      : 64 + __builtin_ctzll ((unsigned long long) (n >> 64)));
+    }
+}
+
+// Instead of stripping the factors of two a bit at a time, count them
+// and shift them all out at once.  In the loop both numbers are odd, so
+// their difference is even; keep the smaller one and the difference,
+// which the compiler does with conditional moves rather than a branch.
+
 template<BinaryInteger N>
 N stein_gcd (N m, N n)
 {
@@ -67,35 +111,87 @@ N stein_gcd (N m, N n)
   if (n == N(0))
     return m;
 
-  int d_m = 0;
-  while (even (m))
+  const int d = std::min (ctz (m), ctz (n));
+  m >>= ctz (m);
+  do
     {
-      m >>= 1;
-      ++d_m;
+      n >>= ctz (n);
+      // odd (m) && odd (n)
+      const N lo = std::min (m, n);
+      n = std::max (m, n) - lo;
+      m = lo;
     }
+  while (n != N(0));
+
+  return m << d;
+}
+
+// No signs to fix up for unsigned types.  For 64 bits, also start
+// counting the zeros of the next difference before we know which of the
+// two numbers is bigger: N - M wraps when N < M, but the negated value
+// has the same trailing zeros, so the count is off the critical path.
+
+template<>
+std::uint64_t stein_gcd (std::uint64_t m, std::uint64_t n)
+{
+  if (m == 0)
+    return n;
+  if (n == 0)
+    return m;
 
-  int d_n = 0;
-  while (even (n))
+  int zm = std::countr_zero (m);
+  const int zn = std::countr_zero (n);
+  const int d = std::min (zm, zn);
+  n >>= zn;
+  while (m != 0)
     {
-      n >>= 1;
-      ++d_n;
+      m >>= zm;
+      // odd (m) && odd (n)
+      const std::uint64_t t = n - m;
+      zm = std::countr_zero (t);
+      const std::uint64_t lo = std::min (m, n);
+      m = std::max (m, n) - lo;
+      n = lo;
     }
+  return n << d;
+}
 
-  // odd (m) && odd (n)
+template<>
+unsigned __int128 stein_gcd (unsigned __int128 m, unsigned __int128 n)
+{
+  if (m == 0)
+    return n;
+  if (n == 0)
+    return m;
 
-  while (m != n)
+  const int d = ctz (m | n);
+  m >>= ctz (m);
+  do
     {
-      if (n > m)
-	std::swap (n, m);
-      m -= n;
-      do
-	m >>= 1;
-      while (even (m));
+      n >>= ctz (n);
+      const unsigned __int128 lo = m < n ? m : n;
+      n = (m < n ? n : m) - lo;
+      m = lo;
+      // Once both fit in 64 bits, the rest is cheaper there.
+      if ((m | n) >> 64 == 0)
+	return (unsigned __int128) stein_gcd (std::uint64_t (m),
+					       std::uint64_t (n)) << d;
     }
+  while (n != 0);
 
-  // m == n
+  return m << d;
+}
+
+// Pseudo-random numbers for the tests.
 
-  return m << std::min (d_m, d_n);
+static std::uint64_t
+xorshift ()
+{
+  static std::uint64_t x = 88172645463325252ull;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
 }
 
 int
@@ -111,4 +207,45 @@ main ()
     __builtin_abort ();
   if (stein_gcd (196, 42) != 14)
     __builtin_abort ();
+  if (stein_gcd (-196, 42) != 14)
+    __builtin_abort ();
+
+  for (int i = 0; i < 100000; ++i)
+    {
+      std::uint64_t a = xorshift () >> (i % 64), b = xorshift () >> (i % 61);
+      std::uint64_t g = xorshift () >> 40 | 1;
+      if (i % 3 == 0)
+	a = (a >> 24) * g, b = (b >> 24) * g;
+      std::uint64_t r = std::gcd (a, b);
+      if (stein_gcd (a, b) != r || stein_gcd ((long long) (a >> 1),
+					     (long long) (b >> 1))
+				   != (long long) std::gcd (a >> 1, b >> 1))
+	__builtin_abort ();
+      unsigned __int128 wa = (unsigned __int128) a * g, wb = b;
+      wb *= g;
+      if (stein_gcd (wa, wb) != gcd (wa, wb))
+	__builtin_abort ();
+    }
+  if (stein_gcd (~0ull, 0ull) != ~0ull || stein_gcd (0ul, 0ul) != 0)
+    __builtin_abort ();
+
+  // Lehmer agrees with the binary GCD, including on Fibonacci numbers,
+  // where every quotient is 1.
+  using big = wide_uint<512>;
+  for (int i = 0; i < 1000; ++i)
+    {
+      big g = random_wide_uint<512> (1 + i % 200);
+      big a = random_wide_uint<512> (1 + i % 300) * g;
+      big b = random_wide_uint<512> (1 + i % 310) * g;
+      if (lehmer_gcd (a, b) != binary_gcd (a, b))
+	__builtin_abort ();
+    }
+  big f0 = 0, f1 = 1;
+  for (int i = 0; i < 700; ++i)
+    {
+      std::swap (f0, f1);
+      f1 += f0;
+    }
+  if (lehmer_gcd (f1, f0) != 1 || lehmer_gcd (f1 * 3, f0 * 3) != 3)
+    __builtin_abort ();
 }
@@ -0,0 +1,59 @@
+// Benchmarks for horner.cc: Horner's rule and Estrin's scheme at one
+// point at a time, and the batch horner over many points.  See bench.h
+// for how to build and run it.
+// Use -std=c++20 -O2, and -march=native to get SIMD in the batch.
+
+#include "bench.h"
+#include <string>
+
+/* Take the functions from horner.cc, but not its main.  */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main horner_main
+#include "horner.cc"
+#undef main
+#pragma GCC diagnostic pop
+
+/* Evaluate polynomials of degree N - 1 at POINTS points in the unsigned
+   type U, named NAME.  Ops are points.  */
+
+template<typename U>
+static void
+bench_horner (bench_suite &suite, const char *name, std::size_t n)
+{
+  constexpr std::size_t points = 1024;
+  bench_random rng;
+  std::vector<U> c (n), xs (points), out (points);
+  for (auto &e : c)
+    e = rng ();
+  for (auto &x : xs)
+    x = rng ();
+  const std::span<const U> s (c);
+  const std::string suffix = std::string ("/") + name;
+
+  suite.run ("horner" + suffix, n, points, [&] {
+    for (std::size_t i = 0; i < points; ++i)
+      out[i] = horner (xs[i], s);
+    do_not_optimize (out[0]);
+  });
+  suite.run ("estrin" + suffix, n, points, [&] {
+    for (std::size_t i = 0; i < points; ++i)
+      out[i] = estrin (xs[i], s);
+    do_not_optimize (out[0]);
+  });
+  suite.run ("horner_batch" + suffix, n, points, [&] {
+    horner (std::span<const U> (xs), s, std::span<U> (out));
+    do_not_optimize (out[0]);
+  });
+}
+
+int
+main (int argc, char **argv)
+{
+  bench_suite suite ("horner", argc, argv);
+  for (std::size_t n : sweep (4, 1024, 4))
+    {
+      bench_horner<std::uint32_t> (suite, "u32", n);
+      bench_horner<std::uint64_t> (suite, "u64", n);
+    }
+}
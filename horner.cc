@@ -5,6 +5,7 @@
 #if __cplusplus > 201703L
 
 #include <concepts>
+#include <cstdlib>
 #include <span>
 
 template<std::integral I, typename T, std::size_t N> [[nodiscard]]
@@ -16,6 +17,110 @@ constexpr auto horner (I x, std::span<T, N> s)
   return r;
 }
 
+/* Like horner, but with Estrin's scheme within blocks of four
+   coefficients:
+
+     a x^3 + b x^2 + c x + d = (a x + b) x^2 + (c x + d),
+
+   and Horner's rule in x^4 from block to block.  A block doesn't depend
+   on the running result, so only one multiply-add per four coefficients
+   is on the critical path.  Going further up Estrin's tree doesn't pay:
+   at that point it's the number of multiplications that limits.
+
+   x^4 is only formed once there is a result to multiply by it: with
+   four coefficients, horner never gets to x^4, and for a signed I
+   neither may estrin, or it could overflow where horner doesn't.  */
+
+template<std::integral I, typename T, std::size_t N> [[nodiscard]]
+constexpr auto estrin (I x, std::span<T, N> s)
+{
+  const std::size_t n = s.size ();
+  std::size_t i = n % 4;
+  I r = 0;
+  for (std::size_t j = 0; j < i; ++j)
+    r = r * x + s[j];
+  if (i == n)
+    return r;
+  const I x2 = x * x;
+  auto block = [&] (std::size_t j) {
+    return (s[j] * x + s[j + 1]) * x2 + (s[j + 2] * x + s[j + 3]);
+  };
+  if (i == 0)
+    {
+      r = block (0);
+      i = 4;
+    }
+  if (i < n)
+    {
+      const I x4 = x2 * x2;
+      for (; i < n; i += 4)
+	r = r * x4 + block (i);
+    }
+  return r;
+}
+
+/* Number of points evaluated side by side.  */
+inline constexpr std::size_t horner_lanes = 16;
+
+/* The widest integers the target can multiply in SIMD lanes.  64-bit
+   vector multiplies only came with AVX-512 and SVE; elsewhere GCC
+   emulates them, and that's slower than no SIMD at all.  */
+#if defined __AVX512DQ__ || defined __ARM_FEATURE_SVE
+inline constexpr std::size_t horner_simd_max = 8;
+#else
+inline constexpr std::size_t horner_simd_max = 4;
+#endif
+
+/* Evaluate the polynomial S at every point in XS, into OUT.  The points
+   are independent, so horner_lanes of them go through estrin's steps
+   in lockstep, and GCC turns the loops over the lanes into SIMD code
+   (with -march=native, say).  When I is too wide for that, each point
+   just goes through estrin on its own.  */
+
+template<std::integral I, typename T>
+void horner (std::span<const I> xs, std::span<const T> s, std::span<I> out)
+{
+  constexpr std::size_t L = horner_lanes;
+  const std::size_t n = s.size ();
+  const std::size_t head = n % 4;
+  std::size_t i = 0;
+  if constexpr (sizeof (I) <= horner_simd_max)
+    for (; i + L <= xs.size (); i += L)
+      {
+	I x[L], x2[L], x4[L], r[L];
+	for (std::size_t l = 0; l < L; ++l)
+	  {
+	    x[l] = xs[i + l];
+	    r[l] = 0;
+	  }
+	for (std::size_t j = 0; j < head; ++j)
+	  for (std::size_t l = 0; l < L; ++l)
+	    r[l] = r[l] * x[l] + s[j];
+	/* Powers only as estrin forms them.  */
+	std::size_t j = head;
+	if (j < n)
+	  for (std::size_t l = 0; l < L; ++l)
+	    x2[l] = x[l] * x[l];
+	if (j == 0 && n >= 4)
+	  {
+	    for (std::size_t l = 0; l < L; ++l)
+	      r[l] = (s[0] * x[l] + s[1]) * x2[l] + (s[2] * x[l] + s[3]);
+	    j = 4;
+	  }
+	if (j < n)
+	  for (std::size_t l = 0; l < L; ++l)
+	    x4[l] = x2[l] * x2[l];
+	for (; j < n; j += 4)
+	  for (std::size_t l = 0; l < L; ++l)
+	    r[l] = r[l] * x4[l] + ((s[j] * x[l] + s[j + 1]) * x2[l]
+				   + (s[j + 2] * x[l] + s[j + 3]));
+	for (std::size_t l = 0; l < L; ++l)
+	  out[i + l] = r[l];
+      }
+  for (; i < xs.size (); ++i)
+    out[i] = estrin (xs[i], s);
+}
+
 #else
 
 using size_t = decltype(sizeof(0));
@@ -42,8 +147,47 @@ main ()
   constexpr long int x = 16;
 #if __cplusplus > 201703L
   constexpr auto r = horner (x, std::span{a});
+  static_assert (estrin (x, std::span{a}) == r);
+  static_assert (estrin (x, std::span{a}.first (1)) == 14);
+  static_assert (estrin (x, std::span{a}.first (2)) == 14 * 16 + 4);
 #else
   constexpr auto r = horner (x, a, array_size (a));
 #endif
   static_assert (r == 14979295L);
+#if __cplusplus > 201703L
+  /* Every length up to 100, at many points, in 32 and 64 bits;
+     unsigned, so that overflowing wraps around the same way on every
+     path.  */
+  auto check = [] <typename U> (U) {
+    U c[100], xs[37], out[37];
+    for (U i = 0; i < 100; ++i)
+      c[i] = i * i * 2654435761u + 1;
+    for (U i = 0; i < 37; ++i)
+      xs[i] = U (i * 0x9e3779b97f4a7c15ul);
+    for (std::size_t n = 1; n <= 100; ++n)
+      {
+	std::span<const U> s (c, n);
+	horner (std::span<const U> (xs), s, std::span<U> (out));
+	for (std::size_t i = 0; i < 37; ++i)
+	  if (out[i] != horner (xs[i], s) || estrin (xs[i], s) != out[i])
+	    std::abort ();
+      }
+  };
+  check (0u);
+  check (0ul);
+
+  /* Signed, near the limit: 256^4 overflows an int, but with only four
+     coefficients neither horner nor estrin should form it.  */
+  constexpr int c4[]{ 1, 2, 3, 4 };
+  static_assert (estrin (256, std::span{c4}) == 0x01020304);
+  static_assert (horner (256, std::span{c4}) == 0x01020304);
+  int xs4[horner_lanes + 1], out4[horner_lanes + 1];
+  for (std::size_t i = 0; i <= horner_lanes; ++i)
+    xs4[i] = 256 - int (i);
+  horner (std::span<const int> (xs4), std::span<const int> (c4),
+	  std::span<int> (out4));
+  for (std::size_t i = 0; i <= horner_lanes; ++i)
+    if (out4[i] != horner (xs4[i], std::span{c4}))
+      std::abort ();
+#endif
 }
@@ -5,10 +5,19 @@
 
 #if __cplusplus > 201703L && __cpp_concepts >= 201907L
 
+#include <array>
 #include <concepts>
+#include <cstdint>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <iterator>
 #include <numeric>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "checked.h"
+#include "montgomery.h"
 
 /* Returns true iff N is odd.  */
 
@@ -26,6 +35,35 @@ bool even (I n)
   return !(n & 1);
 }
 
+/* Compute A * B mod M, where 0 <= A, B < M, without overflowing I.
+   Up to 64 bits the product is formed in a type twice as wide as I.
+   Beyond that, most products still fit, and only the others need the
+   slow way.  */
+
+template<std::integral I>
+I mul_mod (I a, I b, I m)
+{
+  if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+    return checked<I, overflow::widen> (a) * b % m;
+  else
+    {
+      const auto p = checked<I, overflow::report> (a) * b;
+      if (!p.overflowed ())
+	return p.value () % m;
+
+      /* There is no wider type, so add and double.  */
+      I r = 0;
+      while (b > 0)
+	{
+	  if (odd (b))
+	    r = r >= m - a ? r - (m - a) : r + a;
+	  a = a >= m - a ? a - (m - a) : a + a;
+	  b >>= 1;
+	}
+      return r;
+    }
+}
+
 /* Modular exponentiation using exponentiation by squaring.  B is the base,
    E the exponent, and M the modulus.  */
 
@@ -35,25 +73,52 @@ I modular_pow (I b, I e, I m)
   if (m == 1)
     return 0;
 
+  /* Odd moduli don't need to divide at all.  */
+  if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+    if (odd (m))
+      {
+	const montgomery mont (m);
+	return mont.from (mont.pow (mont.to (b), e));
+      }
+
   I r = 1;
   b %= m;
   while (e > 0)
     {
       if (odd (e))
-	r = (r * b) % m;
+	r = mul_mod (r, b, m);
       e >>= 1;
-      b = (b * b) % m;
+      b = mul_mod (b, b, m);
     }
   return r;
 }
 
-/* The Miller-Rabin test.  */
+/* SplitMix64.  Used to pick Miller-Rabin witnesses instead of std::rand,
+   which shares one global state between all the threads.  Each thread
+   gets its own generator, seeded with the same constant, so the sequence
+   of witnesses a thread sees is the same from run to run.  */
+
+inline std::uint64_t
+witness_rand ()
+{
+  thread_local std::uint64_t state = 0;
+  std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+/* One round of the Miller-Rabin test with the witness W.  N is odd,
+   N > 3, and N - 1 = 2^K * Q with Q odd.  Returns false iff W proves
+   that N is composite.  */
 
 template<std::integral I>
-bool miller_rabin (I q, I k, I n)
+bool miller_rabin_witness (I w, I q, I k, I n)
 {
-  /* Pick a random integer W in the range [2, n - 2].  */
-  I w = 2 + std::rand () % (n - 4);
+  w %= n;
+  /* A multiple of N doesn't tell us anything.  */
+  if (w == 0)
+    return true;
 
   /* w^q mod n */
   I x = modular_pow (w, q, n);
@@ -63,7 +128,7 @@ bool miller_rabin (I q, I k, I n)
 
   for (I i = 1; i < k; ++i)
     {
-      x = modular_pow (x, I(2), n);
+      x = mul_mod (x, x, n);
       if (x == n - 1)
 	return true;
       if (x == 1)
@@ -74,8 +139,80 @@ bool miller_rabin (I q, I k, I n)
   return false;
 }
 
+/* Likewise, but for N < 2^64 in the Montgomery domain MONT.  This avoids
+   recomputing the Montgomery constants for every witness.  */
+
+inline bool
+miller_rabin_witness (const montgomery &mont, std::uint64_t w,
+		      std::uint64_t q, std::uint64_t k)
+{
+  w %= mont.modulus ();
+  if (w == 0)
+    return true;
+
+  std::uint64_t x = mont.pow (mont.to (w), q);
+
+  if (x == mont.one () || x == mont.minus_one ())
+    return true;
+
+  for (std::uint64_t i = 1; i < k; ++i)
+    {
+      x = mont.mul (x, x);
+      if (x == mont.minus_one ())
+	return true;
+      if (x == mont.one ())
+	return false;
+    }
+
+  return false;
+}
+
+/* The Miller-Rabin test with a random witness.  */
+
+template<std::integral I>
+bool miller_rabin (I q, I k, I n)
+{
+  using U = std::make_unsigned_t<I>;
+
+  U r = witness_rand ();
+  if constexpr (sizeof (U) > sizeof (std::uint64_t))
+    r = (r << 64) | witness_rand ();
+
+  /* Pick a random integer W in the range [2, n - 2].  */
+  I w = 2 + I (r % U (n - 4));
+  return miller_rabin_witness (w, q, k, n);
+}
+
+/* Return the smallest set of witnesses known to have no strong
+   pseudoprimes up to N, so that Miller-Rabin with these witnesses
+   gives an exact answer.  */
+
+inline std::span<const std::uint64_t>
+miller_rabin_witnesses (std::uint64_t n)
+{
+  static constexpr std::uint64_t w1[] = { 2 };
+  static constexpr std::uint64_t w2[] = { 2, 3 };
+  /* Jaeschke: good for n < 4,759,123,141, so all 32-bit N.  */
+  static constexpr std::uint64_t w3[] = { 2, 7, 61 };
+  /* Sinclair: good for every n < 2^64.  */
+  static constexpr std::uint64_t w7[] = { 2, 325, 9375, 28178, 450775,
+					  9780504, 1795265022 };
+  if (n < 2047)
+    return w1;
+  if (n < 1373653)
+    return w2;
+  if (n < 4759123141)
+    return w3;
+  return w7;
+}
+
 /* Return true if N is probably prime, and false if it definitely
-   is not.  Uses the Miller-Rabin test.  */
+   is not.  Uses the Miller-Rabin test.
+
+   For types of up to 64 bits the answer is exact: we use fixed sets of
+   witnesses that are known to have no strong pseudoprimes below the
+   given bound, picking the smallest set that covers N.  Wider types fall
+   back to random witnesses.  */
 
 template<std::integral I>
 bool prime_p (I n)
@@ -91,12 +228,222 @@ bool prime_p (I n)
   while (even (q))
     q /= 2, ++k;
 
-  /* Let's try it 4 times.  */
-  for (int i = 0; i < 4; ++i)
-    if (!miller_rabin (q, k, n))
-      return false;
+  if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+    {
+      const montgomery mont (n);
+      for (auto w : miller_rabin_witnesses (n))
+	if (!miller_rabin_witness (mont, w, q, k))
+	  return false;
+      return true;
+    }
+  else
+    {
+      /* Let's try it 4 times.  */
+      for (int i = 0; i < 4; ++i)
+	if (!miller_rabin (q, k, n))
+	  return false;
+      return true;
+    }
+}
+
+/* Batch interface.  Testing many candidates at once lets us do two
+   things a single prime_p call can't:
 
-  return true;
+   - weed out multiples of small primes several candidates at a time,
+     using SIMD lanes;
+   - run the Miller-Rabin exponentiations of several candidates side by
+     side.  Each modular_pow is one long chain of dependent multiplies,
+     but the chains of different candidates are independent, so the CPU
+     can overlap them.  */
+
+/* Small odd primes along with their inverses mod 2^64.  N is divisible
+   by P iff N * P^-1 mod 2^64 <= (2^64 - 1) / P, which doesn't need
+   a division.  */
+
+struct small_prime_divisor {
+  std::uint64_t p;
+  std::uint64_t inv;
+  std::uint64_t lim;
+};
+
+inline constexpr auto small_prime_divisors = [] {
+  constexpr std::uint64_t ps[] = { 3, 5, 7, 11, 13, 17, 19, 23, 29, 31,
+				   37, 41, 43, 47, 53, 59, 61 };
+  std::array<small_prime_divisor, std::size (ps)> r{};
+  for (std::size_t i = 0; i < r.size (); ++i)
+    {
+      std::uint64_t inv = ps[i];
+      for (int j = 0; j < 5; ++j)
+	inv *= 2 - ps[i] * inv;
+      r[i] = { ps[i], inv, ~std::uint64_t (0) / ps[i] };
+    }
+  return r;
+} ();
+
+/* Number of candidates handled together.  */
+inline constexpr std::size_t prime_batch_lanes = 4;
+
+/* Set COMPOSITE[i] to nonzero if N[i] has a small prime factor other than
+   itself.  This uses GCC's generic vectors, which become AVX2 or AVX-512
+   instructions when those are enabled, and plain scalar code otherwise.  */
+
+inline void
+small_factor_filter (const std::uint64_t *n, std::uint64_t *composite)
+{
+  using v4u64 = std::uint64_t
+    __attribute__ ((vector_size (prime_batch_lanes * sizeof (std::uint64_t))));
+
+  v4u64 v, c = {};
+  std::memcpy (&v, n, sizeof v);
+  for (const auto &d : small_prime_divisors)
+    c |= (v4u64) ((v * d.inv <= d.lim) & (v != d.p));
+  std::memcpy (composite, &c, sizeof c);
+}
+
+/* Run the exact Miller-Rabin test on N[0..L) at once and store the results
+   in OUT.  Every N[i] must be odd and greater than 3.  */
+
+template<std::size_t L>
+void miller_rabin_batch (const std::uint64_t *n, bool *out)
+{
+  const auto mont = [&]<std::size_t... i> (std::index_sequence<i...>) {
+    return std::array<montgomery, L>{ montgomery (n[i])... };
+  } (std::make_index_sequence<L> ());
+
+  std::uint64_t q[L], k[L];
+  std::span<const std::uint64_t> ws[L];
+  for (std::size_t l = 0; l < L; ++l)
+    {
+      k[l] = __builtin_ctzll (n[l] - 1);
+      q[l] = (n[l] - 1) >> k[l];
+      ws[l] = miller_rabin_witnesses (n[l]);
+      out[l] = true;
+    }
+
+  for (std::size_t round = 0; ; ++round)
+    {
+      /* Lanes that are already known composite, or have run out of
+	 witnesses, still go through the motions with a dummy witness;
+	 that keeps the loop below free of lane-dependent control flow.  */
+      bool active[L];
+      bool any = false;
+      std::uint64_t x[L], a[L], e[L];
+      for (std::size_t l = 0; l < L; ++l)
+	{
+	  std::uint64_t w = round < ws[l].size () ? ws[l][round] % n[l] : 0;
+	  active[l] = out[l] && w != 0;
+	  any |= round < ws[l].size () && out[l];
+	  a[l] = mont[l].to (active[l] ? w : 2);
+	  x[l] = mont[l].one ();
+	  e[l] = q[l];
+	}
+      if (!any)
+	return;
+
+      /* Interleaved square-and-multiply.  */
+      for (bool more = true; more; )
+	{
+	  more = false;
+	  for (std::size_t l = 0; l < L; ++l)
+	    {
+	      std::uint64_t m = mont[l].mul (x[l], a[l]);
+	      x[l] = (e[l] & 1) ? m : x[l];
+	      a[l] = mont[l].mul (a[l], a[l]);
+	      e[l] >>= 1;
+	      more |= e[l] != 0;
+	    }
+	}
+
+      /* The squarings are few and data-dependent; do them lane by lane.  */
+      for (std::size_t l = 0; l < L; ++l)
+	{
+	  if (!active[l]
+	      || x[l] == mont[l].one () || x[l] == mont[l].minus_one ())
+	    continue;
+	  bool pass = false;
+	  for (std::uint64_t i = 1; i < k[l] && !pass; ++i)
+	    {
+	      x[l] = mont[l].mul (x[l], x[l]);
+	      if (x[l] == mont[l].minus_one ())
+		pass = true;
+	      else if (x[l] == mont[l].one ())
+		break;
+	    }
+	  out[l] = pass;
+	}
+    }
+}
+
+/* Set OUT[i] to prime_p (NS[i]) for every element of NS.  OUT must be at
+   least as long as NS.  */
+
+template<std::integral I>
+void prime_p (std::span<const I> ns, std::span<bool> out)
+{
+  if constexpr (sizeof (I) > sizeof (std::uint64_t))
+    {
+      for (std::size_t i = 0; i < ns.size (); ++i)
+	out[i] = prime_p (ns[i]);
+    }
+  else
+    {
+      constexpr std::size_t L = prime_batch_lanes;
+
+      /* Candidates that survived trial division, waiting for
+	 Miller-Rabin, and where their results go.  */
+      std::uint64_t pending[L];
+      std::size_t where[L];
+      std::size_t npending = 0;
+
+      auto flush = [&] (std::size_t count) {
+	bool res[L];
+	/* Pad a partial batch with copies of the first candidate.  */
+	for (std::size_t l = count; l < L; ++l)
+	  pending[l] = pending[0];
+	miller_rabin_batch<L> (pending, res);
+	for (std::size_t l = 0; l < count; ++l)
+	  out[where[l]] = res[l];
+      };
+
+      for (std::size_t i = 0; i < ns.size (); i += L)
+	{
+	  std::uint64_t block[L] = {};
+	  std::size_t idx[L];
+	  std::size_t nblock = 0;
+
+	  for (std::size_t j = i; j < i + L && j < ns.size (); ++j)
+	    {
+	      I n = ns[j];
+	      /* Small and even numbers are quick to do one at a time.  */
+	      if (n < 64 || even (n))
+		out[j] = prime_p (n);
+	      else
+		{
+		  block[nblock] = n;
+		  idx[nblock++] = j;
+		}
+	    }
+
+	  std::uint64_t composite[L];
+	  small_factor_filter (block, composite);
+	  for (std::size_t l = 0; l < nblock; ++l)
+	    if (composite[l])
+	      out[idx[l]] = false;
+	    else
+	      {
+		pending[npending] = block[l];
+		where[npending] = idx[l];
+		if (++npending == L)
+		  {
+		    flush (L);
+		    npending = 0;
+		  }
+	      }
+	}
+
+      if (npending > 0)
+	flush (npending);
+    }
 }
 
 /* True iff A and B are coprimes.  */
@@ -111,8 +458,6 @@ bool coprime_p (I a, I b)
 int
 main ()
 {
-  std::srand (std::time (nullptr));
-
   for (int i = 1; i < 102; ++i)
     if (prime_p (i))
       __builtin_printf ("%d ", i);
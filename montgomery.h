@@ -0,0 +1,92 @@
+// Montgomery modular multiplication for odd 64-bit moduli.
+
+#ifndef _GOO_MONTGOMERY_H
+#define _GOO_MONTGOMERY_H 1
+
+#if __cplusplus > 201703L && __cpp_concepts >= 201907L
+
+#include <cstdint>
+
+/* Arithmetic modulo an odd N using Montgomery's representation: a number A
+   is kept as A * R mod N, with R = 2^64.  The product of two numbers in
+   this form is T = A * B * R^2, and T * R^-1 mod N can be computed with
+   two multiplications and a shift (REDC), so no division by N is ever
+   needed.  Intermediate products use 128 bits, therefore any odd N < 2^64
+   works.
+
+   An object of this type is also a monoid operation on numbers in
+   Montgomery form, so it can be passed to power_semigroup and friends.  */
+
+class montgomery {
+public:
+  using u64 = std::uint64_t;
+  using u128 = unsigned __int128;
+
+  /* N must be odd and greater than 1.  */
+  explicit montgomery (u64 n) : n_(n)
+  {
+    /* N^-1 mod 2^64 by Newton's iteration.  N * N = 1 mod 8, so N is
+       correct to 3 bits, and each step doubles that.  */
+    u64 inv = n;
+    for (int i = 0; i < 5; ++i)
+      inv *= 2 - n * inv;
+    ninv_ = inv;
+    /* R mod N and R^2 mod N.  */
+    one_ = -n % n;
+    r2_ = -u128 (n) % n;
+  }
+
+  u64 modulus () const { return n_; }
+
+  /* Return T * R^-1 mod N.  T < N * R.  */
+  u64 reduce (u128 t) const
+  {
+    /* M is chosen so that T - M * N is divisible by R.  The low halves
+       cancel out exactly, so only the high halves need subtracting.  */
+    u64 m = u64 (t) * ninv_;
+    u64 hi = t >> 64;
+    u64 mn = (u128 (m) * n_) >> 64;
+    return hi >= mn ? hi - mn : hi - mn + n_;
+  }
+
+  /* Convert A to and from Montgomery form.  */
+  u64 to (u64 a) const { return reduce (u128 (a % n_) * r2_); }
+  u64 from (u64 a) const { return reduce (a); }
+
+  /* 1 and N - 1 in Montgomery form.  */
+  u64 one () const { return one_; }
+  u64 minus_one () const { return n_ - one_; }
+
+  u64 mul (u64 a, u64 b) const { return reduce (u128 (a) * b); }
+  u64 operator() (u64 a, u64 b) const { return mul (a, b); }
+
+  /* A^E, with A in Montgomery form.  */
+  u64 pow (u64 a, u64 e) const
+  {
+    u64 r = one_;
+    while (e > 0)
+      {
+	if (e & 1)
+	  r = mul (r, a);
+	e >>= 1;
+	a = mul (a, a);
+      }
+    return r;
+  }
+
+private:
+  u64 n_;
+  u64 ninv_;
+  u64 one_;
+  u64 r2_;
+};
+
+inline std::uint64_t
+identity_element (const montgomery &op)
+{
+  return op.one ();
+}
+
+#endif // C++20
+
+#endif // _GOO_MONTGOMERY_H
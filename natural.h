@@ -0,0 +1,687 @@
+// Natural numbers of any size.
+// Use -std=c++20.
+
+#ifndef _GOO_NATURAL_H
+#define _GOO_NATURAL_H 1
+
+#if __cplusplus > 201703L && __cpp_concepts >= 201907L
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bigint.h"
+
+/* The wide_uint in bigint.h has its size fixed at compile time.  When
+   numbers grow without bound, like the nodes of a product tree, we need
+   limbs on the heap instead.  The mp_ functions here work on operands
+   whose lengths are only known at run time.  */
+
+/* R[0..N) += A * M.  Returns the carry out.  */
+
+inline limb
+mp_addmul_1 (limb *r, const limb *a, limb m, std::size_t n)
+{
+  using u128 = unsigned __int128;
+  limb c = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      u128 t = u128 (a[i]) * m + r[i] + c;
+      r[i] = limb (t);
+      c = t >> 64;
+    }
+  return c;
+}
+
+/* R[0..N) -= A * M.  Returns the borrow out.  */
+
+inline limb
+mp_submul_1 (limb *r, const limb *a, limb m, std::size_t n)
+{
+  using u128 = unsigned __int128;
+  limb c = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      u128 t = u128 (a[i]) * m + c;
+      limb lo = limb (t);
+      c = t >> 64;
+      c += r[i] < lo;
+      r[i] -= lo;
+    }
+  return c;
+}
+
+/* R[0..NA+NB) = A * B, schoolbook.  */
+
+inline void
+mp_mul_basecase (limb *r, const limb *a, std::size_t na,
+		 const limb *b, std::size_t nb)
+{
+  std::fill (r, r + na, 0);
+  for (std::size_t j = 0; j < nb; ++j)
+    r[na + j] = mp_addmul_1 (r + j, a, b[j], na);
+}
+
+/* R[0..2N) = A * B, Karatsuba as in mp_mul, with the scratch space in
+   TMP, which needs 6N limbs.  An odd N does N - 1 limbs that way and
+   adds in the products with the top limbs.  */
+
+inline void
+mp_mul_n (limb *r, const limb *a, const limb *b, std::size_t n, limb *tmp)
+{
+  if (n < karatsuba_threshold)
+    {
+      mp_mul_basecase (r, a, n, b, n);
+      return;
+    }
+  if (n % 2 != 0)
+    {
+      mp_mul_n (r, a, b, n - 1, tmp);
+      r[2 * n - 2] = 0;
+      r[2 * n - 1] = mp_addmul_1 (r + n - 1, b, a[n - 1], n);
+      limb c = mp_addmul_1 (r + n - 1, a, b[n - 1], n - 1);
+      mp_add_1 (r + 2 * n - 2, c, 2);
+      return;
+    }
+
+  const std::size_t h = n / 2;
+  const limb *a0 = a, *a1 = a + h, *b0 = b, *b1 = b + h;
+  mp_mul_n (r, a0, b0, h, tmp);
+  mp_mul_n (r + n, a1, b1, h, tmp);
+
+  limb *da = tmp, *db = tmp + h, *d = tmp + n, *mid = tmp + 2 * n;
+  bool neg = false;
+  if (mp_cmp (a0, a1, h) >= 0)
+    mp_sub (da, a0, a1, h);
+  else
+    {
+      mp_sub (da, a1, a0, h);
+      neg = !neg;
+    }
+  if (mp_cmp (b0, b1, h) >= 0)
+    mp_sub (db, b0, b1, h);
+  else
+    {
+      mp_sub (db, b1, b0, h);
+      neg = !neg;
+    }
+  mp_mul_n (d, da, db, h, tmp + 3 * n);
+
+  limb top = mp_add (mid, r, r + n, n);
+  if (neg)
+    top += mp_add (mid, mid, d, n);
+  else
+    top -= mp_sub (mid, mid, d, n);
+  top += mp_add (r + h, r + h, mid, n);
+  mp_add_1 (r + h + n, top, h);
+}
+
+/* Multiplication by number-theoretic transform, for the biggest
+   operands.  The numbers are cut into 16-bit digits, which makes them
+   polynomials in 2^16; the product of the polynomials is a cyclic
+   convolution, and that is a pointwise product after a Fourier
+   transform.  Here the transform is over the integers mod the prime
+   P = 2^64 - 2^32 + 1 rather than over the complex numbers, so it is
+   exact.  P - 1 is divisible by 2^32, so there are roots of unity for
+   transforms of any length we could use, and 2^64 = 2^32 - 1 mod P makes
+   reduction cheap.  A digit of the convolution is at most
+   min (NA, NB) * 4 * (2^16 - 1)^2, which stays below P.  */
+
+namespace ntt {
+
+inline constexpr limb p = 0xffffffff00000001ull;
+
+/* X mod P.  The operands are random, so anything that could go either
+   way is done with masks rather than branches, which would be
+   mispredicted half the time.  */
+
+inline limb
+reduce (unsigned __int128 x)
+{
+  const limb lo = limb (x), hi = limb (x >> 64);
+  const limb hh = hi >> 32, hl = hi & 0xffffffff;
+  /* x = lo + hl 2^64 + hh 2^96 = lo + hl (2^32 - 1) - hh.  A borrow or
+     carry out of 64 bits is worth 2^32 - 1 as well.  */
+  limb t = lo - hh;
+  t -= 0xffffffff & -limb (lo < hh);
+  limb r;
+  const bool c = __builtin_add_overflow (t, hl * 0xffffffff, &r);
+  r += 0xffffffff & -limb (c);
+  return r - (p & -limb (r >= p));
+}
+
+inline limb
+mul (limb a, limb b)
+{
+  return reduce ((unsigned __int128) a * b);
+}
+
+inline limb
+add (limb a, limb b)
+{
+  limb s;
+  const bool c = __builtin_add_overflow (a, b, &s);
+  return s - (p & -limb (c | (s >= p)));
+}
+
+inline limb
+sub (limb a, limb b)
+{
+  return a - b + (p & -limb (a < b));
+}
+
+inline limb
+pow (limb a, limb e)
+{
+  limb r = 1;
+  for (; e; e >>= 1, a = mul (a, a))
+    if (e & 1)
+      r = mul (r, a);
+  return r;
+}
+
+/* Powers of a root of unity of order N, for every power-of-two length
+   up to N: W[LEN/2 + K] is the K-th power of a root of order LEN.  With
+   INVERSE, of the inverse root.  */
+
+inline std::vector<limb>
+roots (std::size_t n, bool inverse)
+{
+  std::vector<limb> w (std::max<std::size_t> (n, 2));
+  for (std::size_t len = 2; len <= n; len <<= 1)
+    {
+      /* 7 generates the multiplicative group mod P.  */
+      limb root = pow (7, (p - 1) / len);
+      if (inverse)
+	root = pow (root, p - 2);
+      const std::size_t half = len / 2;
+      w[half] = 1;
+      for (std::size_t k = 1; k < half; ++k)
+	w[half + k] = mul (w[half + k - 1], root);
+    }
+  return w;
+}
+
+/* The forward transform of A[0..N), N a power of two, by decimation in
+   frequency; the result comes out in bit-reversed order.  Doing the
+   halves depth-first keeps them in cache once they're small enough.  */
+
+inline void
+forward (limb *a, std::size_t n, const limb *w)
+{
+  const std::size_t half = n / 2;
+  for (std::size_t k = 0; k < half; ++k)
+    {
+      const limb u = a[k], v = a[k + half];
+      a[k] = add (u, v);
+      a[k + half] = mul (sub (u, v), w[half + k]);
+    }
+  if (half > 1)
+    {
+      forward (a, half, w);
+      forward (a + half, half, w);
+    }
+}
+
+/* The inverse of forward, by decimation in time, from bit-reversed
+   order back to natural order, given the inverse roots.  The result is
+   N times too big.  */
+
+inline void
+inverse (limb *a, std::size_t n, const limb *w)
+{
+  const std::size_t half = n / 2;
+  if (half > 1)
+    {
+      inverse (a, half, w);
+      inverse (a + half, half, w);
+    }
+  for (std::size_t k = 0; k < half; ++k)
+    {
+      const limb u = a[k], v = mul (a[k + half], w[half + k]);
+      a[k] = add (u, v);
+      a[k + half] = sub (u, v);
+    }
+}
+
+/* The 16-bit digits of A[0..N), in a vector of length LEN.  */
+
+inline std::vector<limb>
+digits (const limb *a, std::size_t n, std::size_t len)
+{
+  std::vector<limb> d (len);
+  for (std::size_t i = 0; i < n; ++i)
+    for (int j = 0; j < 4; ++j)
+      d[4 * i + j] = (a[i] >> (16 * j)) & 0xffff;
+  return d;
+}
+
+} // namespace ntt
+
+/* Above this many limbs in the shorter operand, use the transform.  */
+inline constexpr std::size_t ntt_threshold = 10000;
+
+/* R[0..NA+NB) = A * B by the transform.  Squaring needs one transform
+   less.  */
+
+inline void
+mp_mul_ntt (limb *r, const limb *a, std::size_t na,
+	    const limb *b, std::size_t nb)
+{
+  const std::size_t len = std::bit_ceil (4 * (na + nb));
+  const std::vector<limb> w = ntt::roots (len, false);
+  std::vector<limb> fa = ntt::digits (a, na, len);
+  ntt::forward (fa.data (), len, w.data ());
+  if (a == b && na == nb)
+    for (limb &x : fa)
+      x = ntt::mul (x, x);
+  else
+    {
+      std::vector<limb> fb = ntt::digits (b, nb, len);
+      ntt::forward (fb.data (), len, w.data ());
+      for (std::size_t i = 0; i < len; ++i)
+	fa[i] = ntt::mul (fa[i], fb[i]);
+    }
+  /* Both are in the same scrambled order, so the pointwise product is
+     too, which is just what inverse wants.  */
+  const std::vector<limb> iw = ntt::roots (len, true);
+  ntt::inverse (fa.data (), len, iw.data ());
+  const limb ninv = ntt::pow (len, ntt::p - 2);
+
+  /* Add up the digits, which overlap, into limbs.  */
+  using u128 = unsigned __int128;
+  u128 carry = 0;
+  for (std::size_t i = 0; i < na + nb; ++i)
+    {
+      limb v = 0;
+      for (int j = 0; j < 4; ++j)
+	{
+	  carry += ntt::mul (fa[4 * i + j], ninv);
+	  v |= limb (carry & 0xffff) << (16 * j);
+	  carry >>= 16;
+	}
+      r[i] = v;
+    }
+}
+
+/* R[0..NA+NB) = A * B for NA >= NB.  A is cut into pieces as long as B,
+   so that the pieces can be multiplied with Karatsuba.  */
+
+inline void
+mp_mul_any (limb *r, const limb *a, std::size_t na,
+	    const limb *b, std::size_t nb)
+{
+  if (nb < karatsuba_threshold)
+    {
+      mp_mul_basecase (r, a, na, b, nb);
+      return;
+    }
+  if (nb >= ntt_threshold)
+    {
+      mp_mul_ntt (r, a, na, b, nb);
+      return;
+    }
+  std::vector<limb> tmp (6 * nb), prod (2 * nb);
+  std::fill (r, r + na + nb, 0);
+  for (std::size_t off = 0; off < na; off += nb)
+    {
+      const std::size_t len = std::min (nb, na - off);
+      if (len == nb)
+	mp_mul_n (prod.data (), a + off, b, nb, tmp.data ());
+      else
+	mp_mul_any (prod.data (), b, nb, a + off, len);
+      mp_add (r + off, r + off, prod.data (), len + nb);
+    }
+}
+
+/* Q[0..NA-NB] = A / B and R[0..NB) = A % B, for NA >= NB >= 2 and
+   B[NB - 1] != 0.  Knuth's algorithm D: normalize so that B's top bit
+   is set, then guess each quotient limb from the top two limbs of the
+   remainder, which is off by at most two.  */
+
+inline void
+mp_divrem (limb *q, limb *r, const limb *a, std::size_t na,
+	   const limb *b, std::size_t nb)
+{
+  using u128 = unsigned __int128;
+  const int s = std::countl_zero (b[nb - 1]);
+  std::vector<limb> u (na + 1), v (nb);
+  for (std::size_t i = nb; i-- > 0; )
+    v[i] = (b[i] << s) | (s && i ? b[i - 1] >> (64 - s) : 0);
+  u[na] = s ? a[na - 1] >> (64 - s) : 0;
+  for (std::size_t i = na; i-- > 0; )
+    u[i] = (a[i] << s) | (s && i ? a[i - 1] >> (64 - s) : 0);
+
+  for (std::size_t j = na - nb + 1; j-- > 0; )
+    {
+      const u128 num = (u128 (u[j + nb]) << 64) | u[j + nb - 1];
+      u128 qhat = num / v[nb - 1], rhat = num % v[nb - 1];
+      while (qhat >> 64
+	     || qhat * v[nb - 2] > ((rhat << 64) | u[j + nb - 2]))
+	{
+	  --qhat;
+	  rhat += v[nb - 1];
+	  if (rhat >> 64)
+	    break;
+	}
+      const limb borrow = mp_submul_1 (&u[j], v.data (), limb (qhat), nb);
+      const limb t = u[j + nb];
+      u[j + nb] = t - borrow;
+      if (t < borrow)
+	{
+	  /* QHAT was one too big: add B back.  */
+	  --qhat;
+	  u[j + nb] += mp_add (&u[j], &u[j], v.data (), nb);
+	}
+      q[j] = limb (qhat);
+    }
+  for (std::size_t i = 0; i < nb; ++i)
+    r[i] = (u[i] >> s) | (s ? u[i + 1] << (64 - s) : 0);
+}
+
+/* Below this many limbs in the divisor, long division beats computing
+   a reciprocal.  */
+inline constexpr std::size_t barrett_threshold = 96;
+
+/* A natural number: limbs on the heap, least significant first, with no
+   zero limbs at the top (so zero has none at all).  */
+
+class natural {
+public:
+  natural () = default;
+  natural (limb v)
+  {
+    if (v)
+      d_.push_back (v);
+  }
+  explicit natural (std::vector<limb> d) : d_(std::move (d)) { trim (); }
+  template<std::size_t Bits>
+  explicit natural (const wide_uint<Bits> &v)
+    : d_(v.limbs.begin (), v.limbs.end ())
+  {
+    trim ();
+  }
+
+  /* Truncates like a built-in conversion would.  */
+  template<std::size_t Bits>
+  explicit operator wide_uint<Bits> () const
+  {
+    wide_uint<Bits> r;
+    for (std::size_t i = 0; i < size () && i < r.nlimbs; ++i)
+      r.limbs[i] = d_[i];
+    return r;
+  }
+
+  std::size_t size () const { return d_.size (); }
+  std::span<const limb> limbs () const { return d_; }
+  explicit operator bool () const { return !d_.empty (); }
+  limb low () const { return d_.empty () ? 0 : d_[0]; }
+
+  /* B^K, where B = 2^64 is the limb base.  */
+  static natural limb_power (std::size_t k)
+  {
+    natural r;
+    r.d_.assign (k + 1, 0);
+    r.d_[k] = 1;
+    return r;
+  }
+
+  friend std::size_t bit_width (const natural &a)
+  {
+    return a.d_.empty () ? 0 : 64 * (a.size () - 1)
+				 + std::bit_width (a.d_.back ());
+  }
+
+  friend bool operator== (const natural &, const natural &) = default;
+
+  friend std::strong_ordering
+  operator<=> (const natural &a, const natural &b)
+  {
+    if (a.size () != b.size ())
+      return a.size () <=> b.size ();
+    return mp_cmp (a.d_.data (), b.d_.data (), a.size ()) <=> 0;
+  }
+
+  natural &operator+= (const natural &b)
+  {
+    if (size () < b.size ())
+      d_.resize (b.size ());
+    d_.push_back (0);
+    limb c = mp_add (d_.data (), d_.data (), b.d_.data (), b.size ());
+    mp_add_1 (d_.data () + b.size (), c, size () - b.size ());
+    trim ();
+    return *this;
+  }
+
+  /* *THIS >= B.  */
+  natural &operator-= (const natural &b)
+  {
+    limb c = mp_sub (d_.data (), d_.data (), b.d_.data (), b.size ());
+    for (std::size_t i = b.size (); c && i < size (); ++i)
+      c = d_[i]-- == 0;
+    trim ();
+    return *this;
+  }
+
+  friend natural operator* (const natural &a, const natural &b)
+  {
+    if (!a || !b)
+      return natural ();
+    std::vector<limb> r (a.size () + b.size ());
+    if (a.size () >= b.size ())
+      mp_mul_any (r.data (), a.d_.data (), a.size (), b.d_.data (), b.size ());
+    else
+      mp_mul_any (r.data (), b.d_.data (), b.size (), a.d_.data (), a.size ());
+    return natural (std::move (r));
+  }
+
+  natural &operator*= (const natural &b) { return *this = *this * b; }
+
+  natural &operator<<= (std::size_t s)
+  {
+    if (!*this)
+      return *this;
+    const std::size_t w = s / 64, b = s % 64;
+    d_.resize (size () + w + 1);
+    for (std::size_t i = size (); i-- > 0; )
+      {
+	limb v = i >= w ? d_[i - w] << b : 0;
+	if (b && i > w)
+	  v |= d_[i - w - 1] >> (64 - b);
+	d_[i] = v;
+      }
+    trim ();
+    return *this;
+  }
+
+  natural &operator>>= (std::size_t s)
+  {
+    const std::size_t w = s / 64, b = s % 64;
+    if (w >= size ())
+      return *this = natural ();
+    for (std::size_t i = 0; i + w < size (); ++i)
+      {
+	limb v = d_[i + w] >> b;
+	if (b && i + w + 1 < size ())
+	  v |= d_[i + w + 1] << (64 - b);
+	d_[i] = v;
+      }
+    d_.resize (size () - w);
+    trim ();
+    return *this;
+  }
+
+  natural &operator/= (const natural &b)
+  {
+    return *this = divmod (*this, b).first;
+  }
+
+  natural &operator%= (const natural &b)
+  {
+    return *this = divmod (*this, b).second;
+  }
+
+  friend natural operator+ (natural a, const natural &b) { return a += b; }
+  friend natural operator- (natural a, const natural &b) { return a -= b; }
+  friend natural operator/ (natural a, const natural &b) { return a /= b; }
+  friend natural operator% (natural a, const natural &b) { return a %= b; }
+  friend natural operator<< (natural a, std::size_t s) { return a <<= s; }
+  friend natural operator>> (natural a, std::size_t s) { return a >>= s; }
+
+  /* Divide in place by the single limb D, and return the remainder.  */
+  limb divmod_1 (limb d)
+  {
+    using u128 = unsigned __int128;
+    limb r = 0;
+    for (std::size_t i = size (); i-- > 0; )
+      {
+	u128 t = (u128 (r) << 64) | d_[i];
+	d_[i] = t / d;
+	r = t % d;
+      }
+    trim ();
+    return r;
+  }
+
+  /* Return {A / B, A % B}, B != 0.  Small divisors use long division.
+     Big ones get a reciprocal of B by Newton's method, and the quotient
+     then comes from multiplications only (Barrett), which Karatsuba
+     makes cheaper than long division.  */
+  friend std::pair<natural, natural>
+  divmod (const natural &a, const natural &b)
+  {
+    if (a < b)
+      return { natural (), a };
+    if (b.size () == 1)
+      {
+	natural q = a;
+	limb r = q.divmod_1 (b.d_[0]);
+	return { std::move (q), natural (r) };
+      }
+    if (b.size () < barrett_threshold)
+      {
+	std::vector<limb> q (a.size () - b.size () + 1), r (b.size ());
+	mp_divrem (q.data (), r.data (), a.d_.data (), a.size (),
+		   b.d_.data (), b.size ());
+	return { natural (std::move (q)), natural (std::move (r)) };
+      }
+    return barrett_divmod (a, b, reciprocal (b));
+  }
+
+  friend std::ostream &operator<< (std::ostream &os, natural a)
+  {
+    /* Nineteen decimal digits at a time.  */
+    constexpr limb ten19 = 10000000000000000000ull;
+    std::vector<limb> chunks;
+    do
+      chunks.push_back (a.divmod_1 (ten19));
+    while (a);
+    std::string s = std::to_string (chunks.back ());
+    for (std::size_t i = chunks.size () - 1; i-- > 0; )
+      {
+	std::string c = std::to_string (chunks[i]);
+	s.append (19 - c.size (), '0');
+	s += c;
+      }
+    return os << s;
+  }
+
+private:
+  std::vector<limb> d_;
+
+  void trim ()
+  {
+    while (!d_.empty () && d_.back () == 0)
+      d_.pop_back ();
+  }
+
+  /* floor (B^2K / M), where M has K limbs.  Take the reciprocal of the
+     top half of M, which is correct to about half the bits, and do one
+     Newton step
+
+       X' = X + X (B^2K - M X) / B^2K
+
+     which doubles that.  What's left is an error of a few units.  */
+  static natural reciprocal (const natural &m)
+  {
+    const std::size_t k = m.size ();
+    const natural b2k = limb_power (2 * k);
+    if (k < barrett_threshold)
+      return divmod (b2k, m).first;
+
+    const std::size_t h = k / 2 + 2;
+    natural x = reciprocal (m >> (64 * (k - h))) << (64 * (k - h));
+    natural t = m * x;
+    if (t <= b2k)
+      x += (x * (b2k - t)) >> (128 * k);
+    else
+      x -= ((x * (t - b2k)) >> (128 * k)) + 1;
+
+    t = m * x;
+    while (t > b2k)
+      {
+	x -= 1;
+	t -= m;
+      }
+    for (t += m; t <= b2k; t += m)
+      x += 1;
+    return x;
+  }
+
+  /* A / B and A % B, given MU = reciprocal (B).  Each step divides at
+     most 2K limbs by the K limbs of B (Barrett): the quotient estimate
+
+       floor (floor (X / B^(K-1)) * MU / B^(K+1))
+
+     is short by at most two.  Longer A are done K limbs at a time, like
+     long division with limbs of K limbs.  */
+  static std::pair<natural, natural>
+  barrett_divmod (const natural &a, const natural &m, const natural &mu)
+  {
+    const std::size_t k = m.size ();
+    auto step = [&] (natural x) {
+      natural q = ((x >> (64 * (k - 1))) * mu) >> (64 * (k + 1));
+      x -= q * m;
+      while (x >= m)
+	{
+	  x -= m;
+	  q += 1;
+	}
+      return std::pair{ std::move (q), std::move (x) };
+    };
+
+    if (a.size () <= 2 * k)
+      return step (a);
+    std::size_t pos = a.size () - 2 * k;
+    auto slice = [&] (std::size_t lo, std::size_t hi) {
+      return natural (std::vector<limb> (a.d_.begin () + lo,
+					 a.d_.begin () + hi));
+    };
+    std::vector<limb> q (a.size () - k + 1);
+    auto place = [&] (const natural &part, std::size_t at) {
+      std::copy (part.d_.begin (), part.d_.end (), q.begin () + at);
+    };
+    auto [q0, r] = step (slice (pos, a.size ()));
+    place (q0, pos);
+    while (pos > 0)
+      {
+	const std::size_t c = std::min (k, pos);
+	pos -= c;
+	auto [qc, rc] = step ((r << (64 * c)) + slice (pos, pos + c));
+	place (qc, pos);
+	r = std::move (rc);
+      }
+    return { natural (std::move (q)), std::move (r) };
+  }
+};
+
+#endif // C++20
+
+#endif // _GOO_NATURAL_H
@@ -1,6 +1,8 @@
 // Checking for overflows.
 
+#include "checked.h"
 #include <climits>
+#include <cstdint>
 #include <limits>
 
 #define assert(X) do { if (!(X)) __builtin_abort (); } while(0)
@@ -43,6 +45,28 @@ bool ovf2 (T lhs, T rhs)
 	ret
  */
 
+/* checked<I, P> in checked.h wraps ovf2 and its friends up in a type.
+   With P = overflow::trap, GCC -O2 generates for a + b:
+	movl	%esi, %eax
+	addl	%edi, %eax
+	jo	.L7
+	ret
+.L7:
+	ud2
+   and with P = overflow::unchecked just the addl.  */
+
+int
+add_trap (int a, int b)
+{
+  return (checked<int> (a) + b).value ();
+}
+
+int
+add_unchecked (int a, int b)
+{
+  return (checked<int, overflow::unchecked> (a) + b).value ();
+}
+
 // Explicit instantiations to get the asm.
 template bool ovf1<int>(int, int);
 template bool ovf2<int>(int, int);
@@ -56,4 +80,38 @@ main ()
   assert (ovf2 (INT_MIN, -1));
   assert (!ovf1 (unsigned(INT_MAX), 1u));
   assert (!ovf2 (unsigned(INT_MAX), 1u));
+
+  using sat = checked<int, overflow::saturate>;
+  static_assert ((sat (INT_MAX) + 1).value () == INT_MAX);
+  static_assert ((sat (INT_MIN) - 1).value () == INT_MIN);
+  static_assert ((sat (INT_MIN) + -1).value () == INT_MIN);
+  static_assert ((sat (65536) * 65536).value () == INT_MAX);
+  static_assert ((sat (-65536) * 65536).value () == INT_MIN);
+  static_assert ((sat (1) << 31).value () == INT_MAX);
+  static_assert ((sat (-1) << 31).value () == INT_MIN);
+  static_assert ((sat (1) << 30).value () == 1 << 30);
+  static_assert ((sat (3) << 100).value () == INT_MAX);
+  static_assert ((checked<unsigned, overflow::saturate> (1) - 2).value ()
+		 == 0);
+  static_assert ((checked<unsigned, overflow::saturate> (1) << 31).value ()
+		 == 1u << 31);
+
+  using rep = checked<std::uint64_t, overflow::report>;
+  constexpr rep big = rep (1) << 63;
+  static_assert (!big.overflowed ());
+  static_assert ((big + big).overflowed ());
+  static_assert ((big + big - 1).overflowed ());
+  static_assert ((big + big).value () == 0);
+  static_assert (!(big * 1 + (big - 1)).overflowed ());
+
+  static_assert ((checked<std::int64_t, overflow::widen> (INT64_MAX)
+		  * INT64_MAX) > INT64_MAX);
+  static_assert ((checked<std::uint32_t, overflow::widen> (UINT32_MAX)
+		  * UINT32_MAX) == 0xfffffffe00000001ull);
+
+  using wrap = checked<int, overflow::unchecked>;
+  assert ((wrap (INT_MAX) + 1).value () == INT_MIN);
+  assert (add_unchecked (INT_MAX, 1) == INT_MIN);
+  assert (add_trap (INT_MAX - 1, 1) == INT_MAX);
+  static_assert (checked<int> (2) * 3 == 6 && checked<int> (2) < 3);
 }
@@ -0,0 +1,82 @@
+// Benchmarks for miller-rabin.h: prime_p, one at a time and batched, and
+// modular_pow.  See bench.h for how to build and run it.
+// Use -std=c++20 -O2, and -march=native to get the SIMD prefilter.
+
+#include "bench.h"
+#include "miller-rabin.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+#define assert(X) do { if (!(X)) std::abort (); } while(0)
+
+/* Test COUNT odd numbers starting at FIRST both ways, after checking
+   that the two agree.  */
+
+static void
+bench_prime_p (bench_suite &suite, const char *name, std::uint64_t first,
+	       std::size_t count)
+{
+  std::vector<std::uint64_t> ns (count);
+  for (std::size_t i = 0; i < count; ++i)
+    ns[i] = first + 2 * i;
+  auto out = std::make_unique<bool[]> (count);
+  const std::span<bool> outs (out.get (), count);
+
+  prime_p (std::span<const std::uint64_t> (ns), outs);
+  for (std::size_t i = 0; i < count; ++i)
+    assert (out[i] == prime_p (ns[i]));
+
+  suite.run (std::string ("prime_p/scalar/") + name, count, count, [&] {
+    for (std::size_t i = 0; i < count; ++i)
+      out[i] = prime_p (ns[i]);
+    do_not_optimize (out[0]);
+  });
+  suite.run (std::string ("prime_p/batch/") + name, count, count, [&] {
+    prime_p (std::span<const std::uint64_t> (ns), outs);
+    do_not_optimize (out[0]);
+  });
+}
+
+/* modular_pow with random bases and full-size exponents, modulo random
+   numbers of BITS bits that are ODD or even.  */
+
+static void
+bench_modular_pow (bench_suite &suite, int bits, bool odd_m)
+{
+  constexpr std::size_t count = 1000;
+  bench_random rng;
+  std::vector<std::uint64_t> b (count), e (count), m (count);
+  const std::uint64_t top = std::uint64_t (1) << (bits - 1);
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      m[i] = (rng () >> (64 - bits) | top) & ~std::uint64_t (1);
+      m[i] |= odd_m;
+      b[i] = rng () % m[i];
+      e[i] = rng () >> (64 - bits);
+    }
+  suite.run (std::string ("modular_pow/") + (odd_m ? "odd/" : "even/")
+	     + std::to_string (bits), bits, count, [&] {
+    std::uint64_t sink = 0;
+    for (std::size_t i = 0; i < count; ++i)
+      sink += modular_pow (b[i], e[i], m[i]);
+    do_not_optimize (sink);
+  });
+}
+
+int
+main (int argc, char **argv)
+{
+  bench_suite suite ("prime", argc, argv);
+
+  for (std::size_t count : sweep (1000, 100000))
+    {
+      bench_prime_p (suite, "32-bit", 3000000001ul, count);
+      bench_prime_p (suite, "64-bit", 1000000000000000001ul, count);
+      bench_prime_p (suite, "63-bit", 9000000000000000001ul, count);
+    }
+
+  for (int bits : { 16, 32, 48, 64 })
+    for (bool odd_m : { true, false })
+      bench_modular_pow (suite, bits, odd_m);
+}
@@ -1,9 +1,20 @@
 // Primality testing.  Carmichael numbers.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <concepts>
+#include <cstdint>
 #include <cstdlib>
 #include <initializer_list>
 #include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "checked.h"
+#include "montgomery.h"
 
 #define assert(X) do { if (!(X)) std::abort (); } while(0)
 
@@ -17,7 +28,9 @@ prime_p (int n)
   else if ((n % 2) == 0 || (n % 3) == 0)
     return false;
   int i = 5;
-  while (i * i <= n)
+  /* I * I goes past INT_MAX before I gets past sqrt (N) when N is a
+     prime near INT_MAX.  */
+  while (checked<int, overflow::widen> (i) * i <= n)
     {
       if ((n % i) == 0 || n % (i + 2) == 0)
 	return false;
@@ -74,7 +87,7 @@ I smallest_divisor (I n)
   if (even (n))
     return 2;
 
-  for (I i = 3; i * i <= n; i+= 2)
+  for (I i = 3; checked<I, overflow::widen> (i) * i <= n; i+= 2)
     if (divides (i, n))
       return i;
   return n;
@@ -96,8 +109,25 @@ struct modulo_multiply {
   I modulus;
   modulo_multiply(const I& i) : modulus(i) {}
 
-  I operator() (const I& n, const I& m) const {
-    return (n * m) % modulus;
+  I operator() (I n, I m) const {
+    if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+      /* Widen so that the product can't overflow.  */
+      return checked<I, overflow::widen> (n) * m % modulus;
+    else
+      {
+	/* Only products that overflow need to go the slow way.  */
+	const auto p = checked<I, overflow::report> (n) * m;
+	if (!p.overflowed ())
+	  return p.value () % modulus;
+	I r = 0;
+	for (n %= modulus; m > 0; m >>= 1)
+	  {
+	    if (odd (m))
+	      r = r >= modulus - n ? r - (modulus - n) : r + n;
+	    n = n >= modulus - n ? n - (modulus - n) : n + n;
+	  }
+	return r;
+      }
   }
 };
 
@@ -150,6 +180,133 @@ A power_semigroup (A a, N n, Op op)
   return power_accumulate_semigroup (a, op (a, a), half (n - 1), op);
 }
 
+/* How power_semigroup_window picks its multiplications.  SLIDING skips
+   runs of zero bits and only keeps odd powers in its table.  FIXED does
+   the same sequence of operations for every exponent of a given bit
+   length: each window costs K squarings and one multiplication, and the
+   table entry is found by reading the whole table, so neither the timing
+   nor the memory accesses depend on the bits of the exponent.  */
+
+enum class power_mode { sliding, fixed };
+
+/* The window width for an exponent with BITS bits.  Sliding windows of
+   width K cost 2^(K-1) multiplications for the table and about
+   BITS / (K + 1) for the windows; these are where the sum is smallest.  */
+
+constexpr int
+power_window_bits (int bits)
+{
+  if (bits <= 8)
+    return 1;
+  if (bits <= 24)
+    return 2;
+  if (bits <= 80)
+    return 3;
+  if (bits <= 240)
+    return 4;
+  return 5;
+}
+
+/* C ? X : Y, without a branch for integers.  */
+
+template<regular_type A>
+A select (bool c, const A &x, const A &y)
+{
+  if constexpr (std::is_integral_v<A>)
+    {
+      const A m = -A (c);
+      return (x & m) | (y & ~m);
+    }
+  else
+    return c ? x : y;
+}
+
+/* A^N using windows of several bits of N at a time, for N > 0.  Where
+   power_semigroup multiplies once for every set bit, this multiplies
+   once per window, from a small table of precomputed powers of A.  */
+
+template<regular_type A, std::integral N, semigroup_op Op>
+A power_semigroup_window (A a, N n, Op op,
+			  power_mode mode = power_mode::sliding)
+{
+  assert (n > 0);
+  using U = std::make_unsigned_t<N>;
+  const U e = n;
+  const int bits = std::bit_width (e);
+  const int k = power_window_bits (bits);
+  auto digit = [e] (int lo, int w) {
+    return unsigned (e >> lo) & ((1u << w) - 1);
+  };
+  std::array<A, 31> table;
+
+  if (mode == power_mode::sliding)
+    {
+      /* TABLE[I] = A^(2I + 1).  */
+      table[0] = a;
+      if (k > 1)
+	{
+	  const A a2 = op (a, a);
+	  for (int i = 1; i < 1 << (k - 1); ++i)
+	    table[i] = op (table[i - 1], a2);
+	}
+      /* The top bit is set, so the first window is never empty.  */
+      A r = a;
+      bool started = false;
+      for (int i = bits - 1; i >= 0; )
+	{
+	  if (!((e >> i) & 1))
+	    {
+	      r = op (r, r);
+	      --i;
+	      continue;
+	    }
+	  /* The longest window starting at bit I that ends in a one.  */
+	  int lo = std::max (i - k + 1, 0);
+	  while (!((e >> lo) & 1))
+	    ++lo;
+	  const int w = i - lo + 1;
+	  if (started)
+	    {
+	      for (int j = 0; j < w; ++j)
+		r = op (r, r);
+	      r = op (r, table[digit (lo, w) >> 1]);
+	    }
+	  else
+	    r = table[digit (lo, w) >> 1];
+	  started = true;
+	  i = lo - 1;
+	}
+      return r;
+    }
+
+  /* TABLE[I] = A^(I + 1).  */
+  table[0] = a;
+  for (int i = 1; i < (1 << k) - 1; ++i)
+    table[i] = op (table[i - 1], a);
+  auto lookup = [&] (unsigned d) {
+    /* D > 0.  */
+    A x = table[0];
+    for (int i = 1; i < (1 << k) - 1; ++i)
+      x = select (unsigned (i) == d - 1, table[i], x);
+    return x;
+  };
+  /* The top window is whatever is left over above the whole windows;
+     it contains the top bit, so it isn't zero.  */
+  int lo = (bits - 1) / k * k;
+  A r = lookup (digit (lo, bits - lo));
+  while (lo > 0)
+    {
+      lo -= k;
+      for (int j = 0; j < k; ++j)
+	r = op (r, r);
+      /* A zero window still does the multiplication, and throws it
+	 away.  */
+      const unsigned d = digit (lo, k);
+      r = select (d != 0, op (r, lookup (d)), r);
+    }
+  return r;
+}
+
 template<regular_type A, std::integral N, monoid_op Op>
 A power_monoid (A a, N n, Op op)
 {
@@ -168,7 +325,15 @@ A power_monoid (A a, N n, Op op)
 template<std::integral I>
 I multiplicative_inverse_fermat (I a, I p)
 {
-  return power_monoid (a, p - 2, modulo_multiply<I>(p));
+  if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+    if (odd (p))
+      {
+	const montgomery mont (p);
+	return mont.from (power_semigroup_window (mont.to (a), p - 2, mont));
+      }
+  if (p == 2)
+    return 1;
+  return power_semigroup_window (a, p - 2, modulo_multiply<I>(p));
 }
 
 /* Fermat's Little Theorem:
@@ -187,7 +352,15 @@ template<std::integral I>
 bool fermat_test (I n, I a)
 {
   assert (a > 0 && a < n);
-  I r = power_semigroup (a, n - 1, modulo_multiply<I>(n));
+  /* For odd N, do the multiplications in Montgomery form.  */
+  if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+    if (odd (n))
+      {
+	const montgomery mont (n);
+	return (power_semigroup_window (mont.to (a), n - 1, mont)
+		== mont.one ());
+      }
+  I r = power_semigroup_window (a, n - 1, modulo_multiply<I>(n));
   return r == 1;
 }
 
@@ -217,7 +390,6 @@ static void
 try_carm ()
 {
   constexpr int n = 172081;
-  // NB: larger numbers would cause an overflow.
   for (auto i : { 9, 81, 123 })
     {
       if (coprime_p (n, i) && fermat_test (n, i))
@@ -236,14 +408,22 @@ I modular_pow (I b, I e, I m)
   if (m == 1)
     return 0;
 
+  if constexpr (sizeof (I) <= sizeof (std::uint64_t))
+    if (odd (m))
+      {
+	const montgomery mont (m);
+	return mont.from (power_monoid (mont.to (b), e, mont));
+      }
+
+  modulo_multiply<I> mmult (m);
   I r = 1;
   b %= m;
   while (e > 0)
     {
       if (odd (e))
-	r = (r * b) % m;
+	r = mmult (r, b);
       e >>= 1;
-      b = (b * b) % m;
+      b = mmult (b, b);
     }
   return r;
 }
@@ -272,38 +452,188 @@ bool is_carmichael (I n)
   return true;
 }
 
+/* is_carmichael tries every base, so it is hopeless for anything but
+   small N.  Korselt's criterion says the same thing without any modular
+   exponentiation: a composite N is a Carmichael number iff N is
+   squarefree and p - 1 divides N - 1 for every prime p dividing N.
+   Such N are always odd, and have at least three prime factors.
+
+   To check that for every N in a range we sieve it with the primes up to
+   sqrt (LIMIT), chunk by chunk.  Writing an odd multiple of p as
+   N = p * m, with m odd:
+
+     p^2 | N       iff  p | m
+     p - 1 | N - 1 iff  m = 1 (mod p - 1),  as N - 1 = (p - 1) m + m - 1
+
+   and m just goes up by 2 from one odd multiple to the next, so both
+   tests only need counters, not divisions.  Whatever is left of N after
+   dividing out the small primes is 1 or a single large prime.  */
+
+/* Odd numbers per chunk.  */
+constexpr std::uint64_t carmichael_chunk = 1 << 16;
+
+/* Append the Carmichael numbers in the odd numbers LO, LO + 2, ...,
+   below HI to OUT.  PRIMES are the odd primes up to sqrt (HI).  */
+
+static void
+carmichael_chunk_scan (std::uint64_t lo, std::uint64_t hi,
+		       const std::vector<std::uint64_t> &primes,
+		       std::vector<std::uint64_t> &out)
+{
+  const std::uint64_t count = (hi - lo + 1) / 2;
+  /* What remains of N after dividing out the small primes, and how
+     many of those there were.  A zero means N has failed.  */
+  std::vector<std::uint64_t> rem (count);
+  std::vector<unsigned char> nfactors (count);
+  for (std::uint64_t j = 0; j < count; ++j)
+    rem[j] = lo + 2 * j;
+
+  for (std::uint64_t p : primes)
+    {
+      if (p * p >= hi)
+	break;
+      /* The first odd multiple of P that is >= LO, as P * M.  */
+      std::uint64_t m = (lo + p - 1) / p;
+      if (even (m))
+	++m;
+      std::uint64_t j = (p * m - lo) / 2;
+      std::uint64_t m_mod_p = m % p;
+      std::uint64_t m_mod_p1 = m % (p - 1);
+      for (; j < count; j += p)
+	{
+	  if (rem[j] != 0)
+	    {
+	      if (m_mod_p == 0 || m_mod_p1 != 1 % (p - 1))
+		rem[j] = 0;
+	      else
+		{
+		  rem[j] /= p;
+		  ++nfactors[j];
+		}
+	    }
+	  if ((m_mod_p += 2) >= p)
+	    m_mod_p -= p;
+	  if ((m_mod_p1 += 2) >= p - 1)
+	    m_mod_p1 -= p - 1;
+	}
+    }
+
+  for (std::uint64_t j = 0; j < count; ++j)
+    {
+      std::uint64_t n = lo + 2 * j;
+      std::uint64_t q = rem[j];
+      if (q == 0)
+	continue;
+      if (q == 1
+	  ? nfactors[j] >= 2
+	  : nfactors[j] >= 1 && (n - 1) % (q - 1) == 0)
+	out.push_back (n);
+    }
+}
+
+/* Return all the Carmichael numbers <= LIMIT, in increasing order.  The
+   range is cut into chunks that THREADS threads take in turns.  */
+
+static std::vector<std::uint64_t>
+carmichael_numbers (std::uint64_t limit,
+		    unsigned threads
+		      = std::max (1u, std::thread::hardware_concurrency ()))
+{
+  /* Odd primes up to sqrt (LIMIT).  */
+  std::uint64_t root = 1;
+  while (checked<std::uint64_t, overflow::widen> (root + 1) * (root + 1)
+	 <= limit)
+    ++root;
+  std::vector<char> composite (root + 1);
+  std::vector<std::uint64_t> primes;
+  for (std::uint64_t i = 3; i <= root; i += 2)
+    if (!composite[i])
+      {
+	primes.push_back (i);
+	for (std::uint64_t k = i * i; k <= root; k += 2 * i)
+	  composite[k] = true;
+      }
+
+  /* The smallest Carmichael number is 561.  */
+  constexpr std::uint64_t first = 561;
+  if (limit < first)
+    return {};
+  const std::uint64_t nchunks
+    = ((limit - first) / 2 + carmichael_chunk) / carmichael_chunk;
+
+  std::atomic<std::uint64_t> next_chunk = 0;
+  std::vector<std::vector<std::uint64_t>> found (threads);
+  auto work = [&] (unsigned t) {
+    for (std::uint64_t c; (c = next_chunk++) < nchunks; )
+      {
+	std::uint64_t lo = first + 2 * carmichael_chunk * c;
+	std::uint64_t hi = std::min (lo + 2 * carmichael_chunk, limit + 1);
+	carmichael_chunk_scan (lo, hi, primes, found[t]);
+      }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+    pool.emplace_back (work, t);
+  work (0);
+  for (auto &th : pool)
+    th.join ();
+
+  std::vector<std::uint64_t> r;
+  for (const auto &f : found)
+    r.insert (r.end (), f.begin (), f.end ());
+  std::sort (r.begin (), r.end ());
+  return r;
+}
+
 /* Find the first N Carmichael numbers.  */
 
 static void
 find_first_n_carmichaels (int n)
 {
   __builtin_printf ("First %d Carmichael numbers:", n);
-  for (int i = 2; i < std::numeric_limits<int>::max() && n > 0; ++i)
-    if (is_carmichael (i))
-      {
-	__builtin_printf (" %d", i);
-	--n;
-      }
+  std::vector<std::uint64_t> v;
+  for (std::uint64_t limit = 1024; v.size () < std::size_t (n); limit *= 4)
+    v = carmichael_numbers (limit);
+  for (int i = 0; i < n; ++i)
+    __builtin_printf (" %lu", v[i]);
   __builtin_printf ("\n");
 }
 
 /* Return true if N is probably prime, and false if it definitely
-   is not.  Uses the Miller-Rabin test.  */
+   is not.  Uses the Miller-Rabin test, in Montgomery form up to 64 bits
+   and with modulo_multiply above that.  */
 
 template<std::integral I>
 bool miller_rabin_test (I n, I q, I k, I w)
 {
   /* Assume n > 1 && n - 1 = 2^k * q && odd (q) */
-  modulo_multiply<I> mmult (n);
-  I x = power_semigroup (w, q, mmult);
-  if (x == 1 || x == n - 1)
+  if constexpr (sizeof (I) > sizeof (std::uint64_t))
+    {
+      modulo_multiply<I> mmult (n);
+      I x = power_semigroup (w, q, mmult);
+      if (x == 1 || x == n - 1)
+	return true;
+      for (I i = 1; i < k; ++i)
+	{
+	  x = mmult (x, x);
+	  if (x == n - 1)
+	    return true;
+	  if (x == 1)
+	    return false;
+	}
+      return false;
+    }
+  const montgomery mont (n);
+  std::uint64_t x = power_semigroup_window (mont.to (w), q, mont);
+  if (x == mont.one () || x == mont.minus_one ())
     return true;
   for (I i = 1; i < k; ++i)
     {
-      x = mmult (x, x);
-      if (x == n - 1)
+      x = mont (x, x);
+      if (x == mont.minus_one ())
 	return true;
-      if (x == 1)
+      if (x == mont.one ())
 	return false;
     }
   return false;
@@ -328,6 +658,32 @@ main ()
 
   assert (modular_pow (5, 3, 13) == 8);
   assert (modular_pow (4, 13, 497) == 445);
+  assert (modular_pow (3, 5, 16) == 3);
+
+  /* Full 64-bit moduli work too.  */
+  constexpr unsigned long p64 = 18446744073709551557ul;
+  assert (fermat_test (p64, 2ul));
+  assert (fermat_test (p64, p64 - 2));
+  assert (modular_pow (2ul, p64 - 1, p64) == 1);
+  assert (modulo_multiply (p64) (multiplicative_inverse_fermat (3ul, p64), 3ul)
+	  == 1);
+  /* A strong pseudoprime to bases 2, 3, 5 and 7.  */
+  assert (miller_rabin_test (3215031751ul, 1607515875ul, 1ul, 7ul));
+  assert (!miller_rabin_test (3215031751ul, 1607515875ul, 1ul, 11ul));
+
+  /* Windowed exponentiation agrees with the binary method.  */
+  {
+    const modulo_multiply<unsigned long> mm (1000000007ul);
+    for (unsigned long e = 1; e < 3000; e += 7)
+      for (auto mode : { power_mode::sliding, power_mode::fixed })
+	assert (power_semigroup_window (3ul, e, mm, mode)
+		== power_semigroup (3ul, e, mm));
+    const montgomery mont (p64);
+    for (unsigned long e : { p64 - 1, p64 - 2, 1ul << 63, ~0ul })
+      for (auto mode : { power_mode::sliding, power_mode::fixed })
+	assert (power_semigroup_window (mont.to (5), e, mont, mode)
+		== power_semigroup (mont.to (5), e, mont));
+  }
 
   assert (is_carmichael (172081L));
   assert (!is_carmichael (7753));
@@ -338,6 +694,40 @@ main ()
 
   find_first_n_carmichaels (7);
 
+  /* Korselt agrees with the definition.  */
+  const auto carm = carmichael_numbers (20000, 3);
+  std::size_t k = 0;
+  for (unsigned long i = 2; i <= 20000; ++i)
+    if (is_carmichael (i))
+      assert (carm[k++] == i);
+  assert (k == carm.size ());
+  assert (carmichael_numbers (1000000).size () == 43);
+  assert (carmichael_numbers (100000000).size () == 255);
+  assert (carmichael_numbers (100000000, 4).back () == 99861985);
+
   assert (!miller_rabin_test (2793, 349, 3, 150));
+
+  /* The largest primes of their types, where I * I overflows.  */
+  assert (prime_p (2147483647));
+  assert (is_prime (2147483647));
+  assert (is_prime (4294967291u));
+  assert (smallest_divisor (4294967295u) == 3);
+
+#ifndef __STRICT_ANSI__
+  /* Full 128-bit moduli.  __int128 is only std::integral with
+     -std=gnu++20.  */
+  using u128 = unsigned __int128;
+  const u128 p128 = (u128 (1) << 127) - 1;
+  assert (modular_pow (u128 (3), p128 - 1, p128) == 1);
+  assert (modulo_multiply (p128) (p128 - 1, p128 - 1) == 1);
+  assert (modulo_multiply (p128) (u128 (1) << 64, 12345)
+	  == u128 (12345) << 64);
+  /* Miller-Rabin doesn't cut them down to 64 bits.  p128 - 1 is twice
+     an odd number; the other one is (2^64 - 59) (2^61 - 1).  */
+  assert (miller_rabin_test (p128, (u128 (1) << 126) - 1, u128 (1),
+			     u128 (3)));
+  const u128 c128 = u128 (18446744073709551557u) * 2305843009213693951u;
+  assert (!miller_rabin_test (c128, (c128 - 1) / 2, u128 (1), u128 (7)));
+#endif
   assert (!miller_rabin_test (561, 35, 4, 7));
 }
@@ -1,35 +1,64 @@
 // A toy implementation of the RSA algorithm.
 // Use -std=c++20.
 
+#include "bigint.h"
 #include "miller-rabin.h"
+#include "natural.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <numeric>
+#include <span>
+#include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #define assert(X) do { if (!(X)) std::abort (); } while(0)
 
 using key_type = long int;
 using key_pair = std::pair<key_type, key_type>;
 
-/* The ring of integers is an example of a Euclidean domain.  */
+/* Keys of a realistic size.  The modulus has 2048 bits, so P and Q are
+   stored in 2048 bits too, even though they only use half of them.  */
+using big_key_type = wide_uint<2048>;
+
+/* The ring of integers is an example of a Euclidean domain.  So are the
+   wide integers from bigint.h, as far as the algorithms below care: they
+   have the usual arithmetic, division with remainder, and ordering.  */
 template<typename T>
-concept euclidean_domain = std::integral<T>;
+concept euclidean_domain = std::integral<T> || requires (T a, T b) {
+  { a + b } -> std::same_as<T>;
+  { a - b } -> std::same_as<T>;
+  { a * b } -> std::same_as<T>;
+  { a / b } -> std::same_as<T>;
+  { a % b } -> std::same_as<T>;
+  { a < b } -> std::convertible_to<bool>;
+  { a == b } -> std::convertible_to<bool>;
+  T (0);
+};
 
 /* Compute λ(n), where λ is Carmichael's totient function.
 
      λ(n) = lcm(p − 1, q − 1)
  */
 
-template<std::integral I>
+template<euclidean_domain I>
 I carmichael_fn (I p, I q)
 {
-  return std::lcm (p - 1, q - 1);
+  using std::gcd;
+  I a = p - 1;
+  I b = q - 1;
+  return a / gcd (a, b) * b;
 }
 
 /* Generate a prime around N.  */
 
-template<std::integral I>
+template<euclidean_domain I>
 I generate_prime (I n)
 {
   assert (odd (n));
@@ -52,13 +81,16 @@ std::pair<E, E> extended_gcd (E a, E b)
 
   while (b != E(0))
     {
-      auto qr = std::div (a, b);
-      E x2 = x0 - qr.quot * x1;
+      E q = a / b;
+      E r = a - q * b;
+      /* For an unsigned E, the coefficients wrap around; their true
+	 values are bounded by B, so they can still be recovered.  */
+      E x2 = x0 - q * x1;
       /* Shift r and x.  */
       x0 = x1;
       x1 = x2;
       a = b;
-      b = qr.rem;
+      b = r;
     }
 
   return {x0, a};
@@ -81,47 +113,123 @@ E mult_inv_mod (E a, E b)
   /* Also, for getting a result which is positive and lower than n, one may
      use the fact that the integer t provided by the algorithm satisfies
      |t| < n. That is, if t < 0, one must add n to it at the end.  */
-  if (i < 0)
+  if constexpr (std::is_signed_v<E>)
+    {
+      if (i < 0)
+	i += b;
+    }
+  else if (i >= b)
+    /* Wrapped around; it's really negative.  */
     i += b;
 
   return i;
 }
 
-/* Generate a pair of RSA keys.
+/* Replace every element of A by its inverse modulo M with a single
+   extended GCD: invert the product of them all, then peel the elements
+   off one at a time using the prefix products (Montgomery's trick).
+   That's 3(k - 1) modular multiplications instead of k - 1 more
+   extended GCDs, which for big K cost many multiplications each.
+   Returns false, leaving A alone, if some element has no inverse.  */
+
+template<euclidean_domain E>
+bool mult_inv_mod_batch (std::span<E> a, E m)
+{
+  const std::size_t k = a.size ();
+  if (k == 0)
+    return true;
+  std::vector<E> c (k);
+  c[0] = a[0] % m;
+  for (std::size_t i = 1; i < k; ++i)
+    c[i] = mul_mod (c[i - 1], E (a[i] % m), m);
+  auto [inv, g] = extended_gcd (c[k - 1], m);
+  if (!(g == E (1)))
+    return false;
+  /* Into [0, M), as in mult_inv_mod.  */
+  if constexpr (std::is_signed_v<E>)
+    {
+      if (inv < 0)
+	inv += m;
+    }
+  else if (inv >= m)
+    inv += m;
+
+  for (std::size_t i = k - 1; i > 0; --i)
+    {
+      const E ai = a[i] % m;
+      a[i] = mul_mod (inv, c[i - 1], m);
+      inv = mul_mod (inv, ai, m);
+    }
+  a[0] = inv;
+  return true;
+}
+
+/* A private key.  Besides N and D, it keeps what's needed to decrypt
+   with the Chinese remainder theorem: the factors P and Q of N,
+   DP = D mod (P - 1), DQ = D mod (Q - 1), and QINV = Q^-1 mod P.  */
+
+template<euclidean_domain K>
+struct private_key {
+  K n;
+  K d;
+  K p;
+  K q;
+  K dp;
+  K dq;
+  K qinv;
+};
+
+/* The private key that goes with the primes P and Q and the public
+   exponent E.  */
+
+template<euclidean_domain K>
+static private_key<K>
+make_private_key (K p, K q, K e)
+{
+  K n = p * q;
+  /* Compute λ(n), where λ is Carmichael's totient function.  */
+  K l = carmichael_fn (p, q);
+  /* Compute the secret exponend d: de ≡ 1 (mod λ(n)).  */
+  K d = mult_inv_mod (e, l);
+  return {n, d, p, q, d % (p - 1), d % (q - 1), mult_inv_mod (q, p)};
+}
+
+/* Generate a pair of RSA keys: the public key (N, E) and the private
+   key.
 
    Practical implementations use the Chinese remainder theorem to speed up
-   the calculation using modulus of factors (mod pq using mod p and mod q).  */
+   the calculation using modulus of factors (mod pq using mod p and mod q),
+   and so do we; see decrypt below.  */
 
-[[nodiscard]] static std::pair<key_pair, key_pair>
-generate_keys ()
+template<euclidean_domain K = key_type>
+[[nodiscard]] static std::pair<std::pair<K, K>, private_key<K>>
+generate_keys (K p0 = 7919, K q0 = 7331)
 {
-  /* Generate two distinct prime numbers p and q.
-     NB: These are very small, so this whole thing is extremely unsafe.  */
-  key_type p = generate_prime (static_cast<key_type>(7919));
-  key_type q = generate_prime (static_cast<key_type>(7331));
+  /* Generate two distinct prime numbers p and q, around P0 and Q0.
+     NB: The defaults are very small, so this is extremely unsafe.  */
+  K p = generate_prime (p0);
+  K q = generate_prime (q0);
   assert (p != q);
 
   /* Compute n = pq.  */
-  key_type n = p * q;
+  K n = p * q;
 
   /* Compute λ(n), where λ is Carmichael's totient function.  */
-  key_type l = carmichael_fn (p, q);
+  K l = carmichael_fn (p, q);
 
   /* Choose an integer e such that 1 < e < λ(n) and gcd(e, λ(n)) = 1; that is,
      e and λ(n) are coprime.  */
-  key_type e = 65537;
+  K e = 65537;
   assert (coprime_p (e, l));
 
-  /* Compute the secret exponend d: de ≡ 1 (mod λ(n)).  */
-  key_type d = mult_inv_mod (e, l);
-
-  return {{n, e}, {n, d}};
+  return {{n, e}, make_private_key (p, q, e)};
 }
 
 /* Encrypt M using the public key KEY.  */
 
-[[nodiscard]] static key_type
-encrypt (key_type m, key_pair key)
+template<euclidean_domain K>
+[[nodiscard]] static K
+encrypt (std::type_identity_t<K> m, std::pair<K, K> key)
 {
   auto [n, e] = key;
   /* m = 0, 1, n - 1 means an unconcealed message.  */
@@ -131,13 +239,76 @@ encrypt (key_type m, key_pair key)
 
 /* Decrypt C using the private key KEY.  */
 
-[[nodiscard]] static key_type
-decrypt (key_type c, key_pair key)
+template<euclidean_domain K>
+[[nodiscard]] static K
+decrypt (K c, std::pair<K, K> key)
 {
   auto [n, d] = key;
   return modular_pow (c, d, n);
 }
 
+/* P and Q have half as many bits as N, so arithmetic mod P and mod Q can
+   be done in a type half as wide.  */
+
+template<typename K>
+struct crt_half {
+  using type = K;
+  static bool fits (const K &) { return true; }
+};
+
+template<std::size_t Bits>
+  requires (Bits % 128 == 0)
+struct crt_half<wide_uint<Bits>> {
+  using type = wide_uint<Bits / 2>;
+  static bool fits (const wide_uint<Bits> &x)
+  {
+    return bit_width (x) <= Bits / 2;
+  }
+};
+
+/* Decrypt C using the private key KEY and the CRT.  Instead of one
+   exponentiation mod N with a full-size exponent, do two mod P and mod Q
+   with half-size exponents:
+
+     m1 = c^dp mod p
+     m2 = c^dq mod q
+
+   and put m back together with Garner's formula:
+
+     h = qinv * (m1 - m2) mod p
+     m = m2 + h * q
+
+   With 2048-bit keys this is over twice as fast as decrypting with D.  */
+
+template<euclidean_domain K>
+[[nodiscard]] static K
+decrypt (K c, const private_key<K> &key)
+{
+  using half = crt_half<K>;
+  using H = half::type;
+  if (!half::fits (key.p) || !half::fits (key.q))
+    return modular_pow (c, key.d, key.n);
+
+  const H p (key.p), q (key.q);
+  H m1 = modular_pow (H (c % key.p), H (key.dp), p);
+  H m2 = modular_pow (H (c % key.q), H (key.dq), q);
+  H m2p = m2 % p;
+  H diff = m1 >= m2p ? m1 - m2p : m1 + (p - m2p);
+  H h = mul_mod (H (key.qinv), diff, p);
+  return K (m2) + K (h) * key.q;
+}
+
+/* Decrypt every ciphertext in CS into OUT, which must be at least as
+   long.  */
+
+template<euclidean_domain K>
+static void
+decrypt (std::span<const K> cs, const private_key<K> &key, std::span<K> out)
+{
+  for (std::size_t i = 0; i < cs.size (); ++i)
+    out[i] = decrypt (cs[i], key);
+}
+
 /* Return true iff N is divisible by I.  */
 
 template<std::integral I>
@@ -146,20 +317,124 @@ bool divides (I i, I n)
   return n % i == 0;
 }
 
-/* A (naive) attempt to factor a composite number N.  Just try to divide by
-   every odd number starting from 3 up to sqrt (n).
+/* Pollard's rho heuristic: iterate f(x) = x^2 + C mod N.  Modulo an
+   unknown prime factor p of N the sequence must cycle after about
+   sqrt (p) steps, and once it does, gcd (x_i - x_j, N) reveals p.
 
-  TODO: Try Pollard's rho heuristic.  */
+   Cycles are found with Brent's method: compare y against a saved x,
+   and save a new x every time the number of steps doubles.  Rather than
+   taking a gcd for every step, we multiply the differences together and
+   take one gcd per BATCH steps; if that overshoots to N, we redo the last
+   batch one step at a time.  The arithmetic is done in Montgomery form,
+   so there are no overflows and no divisions.
+
+   N is odd and composite.  Returns a nontrivial factor of N, or N if
+   this C didn't work out.  */
+
+template<std::integral I>
+I pollard_brent (I n, std::uint64_t c)
+{
+  constexpr std::uint64_t batch = 128;
+  const montgomery mont (n);
+  const std::uint64_t cm = mont.to (c);
+  /* Adding CM can go past 2^64 when N is above 2^63, so compare with
+     N - CM instead.  */
+  const std::uint64_t n_cm = mont.modulus () - cm;
+  auto f = [&] (std::uint64_t x) {
+    x = mont.mul (x, x);
+    return x >= n_cm ? x - n_cm : x + cm;
+  };
+  auto diff = [] (std::uint64_t a, std::uint64_t b) {
+    return a > b ? a - b : b - a;
+  };
+
+  std::uint64_t y = mont.to (2), x = y, ys = y;
+  std::uint64_t q = mont.one ();
+  std::uint64_t g = 1;
+  for (std::uint64_t r = 1; g == 1; r *= 2)
+    {
+      x = y;
+      for (std::uint64_t i = 0; i < r; ++i)
+	y = f (y);
+      for (std::uint64_t k = 0; k < r && g == 1; k += batch)
+	{
+	  ys = y;
+	  for (std::uint64_t i = 0; i < std::min (batch, r - k); ++i)
+	    {
+	      y = f (y);
+	      q = mont.mul (q, diff (x, y));
+	    }
+	  /* Montgomery form only adds a factor of 2^64, which is coprime
+	     to N.  */
+	  g = std::gcd (q, std::uint64_t (n));
+	}
+    }
+
+  if (g == std::uint64_t (n))
+    do
+      {
+	ys = f (ys);
+	g = std::gcd (diff (x, ys), std::uint64_t (n));
+      }
+    while (g == 1);
+
+  return g;
+}
+
+/* Append the prime factors of N to FACTORS.  */
+
+template<std::integral I>
+void factor_1 (I n, std::vector<I> &factors)
+{
+  if (n == 1)
+    return;
+  if (prime_p (n))
+    {
+      factors.push_back (n);
+      return;
+    }
+  for (std::uint64_t c = 1; ; ++c)
+    {
+      I d = pollard_brent (n, c);
+      if (d != n)
+	{
+	  factor_1 (d, factors);
+	  factor_1 (n / d, factors);
+	  return;
+	}
+    }
+}
+
+/* Return the prime factors of N > 0, with multiplicity, in increasing
+   order.  */
+
+template<std::integral I>
+std::vector<I> factor (I n)
+{
+  std::vector<I> factors;
+  /* Small factors are cheaper to find by trial division, and rho needs
+     an odd N.  */
+  for (I p : { 2, 3, 5, 7, 11, 13 })
+    while (divides (p, n))
+      {
+	factors.push_back (p);
+	n /= p;
+      }
+  factor_1 (n, factors);
+  std::sort (factors.begin (), factors.end ());
+  return factors;
+}
+
+/* Attempt to factor a composite number N.  Returns the smallest prime
+   factor of N, or 0 if N is prime.  */
 
 [[gnu::const]] static key_type
 factor_composite (key_type n)
 {
-  for (key_type i(3); i * i <= n; i += 2)
-    if (divides (i, n))
-      /* Bingo!  */
-      return i;
+  if (n < 4 || prime_p (n))
+    return key_type(0);
 
-  return key_type(0);
+  return factor (n).front ();
 }
 
 /* Given the ciphertext C and the public key KEY, attempt to
@@ -185,7 +460,230 @@ crack (key_type c, key_pair key)
   key_type d = mult_inv_mod (e, l);
 
   /* And decrypt the message.  */
-  return decrypt (c, {n, d});
+  return decrypt (c, key_pair{n, d});
+}
+
+/* Batch GCD.
+
+   Given a large collection of RSA moduli, find the ones that share a
+   prime with some other modulus: such keys are broken, because the
+   shared prime falls out of a GCD.  Taking the GCD of every pair means
+   k^2 GCDs for k moduli.  Bernstein's batch GCD instead computes
+
+     P = n_1 n_2 ... n_k	by a product tree, bottom up,
+     r_i = P mod n_i^2		by a remainder tree, top down,
+     g_i = gcd (n_i, r_i / n_i)
+
+   r_i / n_i is (P / n_i) mod n_i, the product of all the other moduli
+   mod n_i, so g_i is the product of the primes of n_i that also divide
+   some other modulus.  The remainder tree gets from P to the r_i by
+   reducing each node's remainder mod the squares of its children, so
+   the numbers shrink on the way down.
+
+   The tree nodes are naturals from natural.h.  The nodes of one level
+   are independent of each other, so each level is computed on several
+   threads.  With Karatsuba and Newton division the cost is about
+   M (n) log k, where n is the size of P and M (n) ~ n^1.6.  */
+
+template<euclidean_domain K>
+static natural
+to_natural (const K &k)
+{
+  if constexpr (std::integral<K>)
+    return natural (limb (k));
+  else
+    return natural (k);
+}
+
+template<euclidean_domain K>
+static K
+from_natural (const natural &x)
+{
+  if constexpr (std::integral<K>)
+    return K (x.low ());
+  else
+    return K (x);
+}
+
+/* Call F (I) for every I in [0, N), on THREADS threads.  */
+
+template<typename F>
+static void
+parallel_for (std::size_t n, unsigned threads, F f)
+{
+  std::atomic<std::size_t> next = 0;
+  auto work = [&] {
+    for (std::size_t i; (i = next++) < n; )
+      f (i);
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads && t < n; ++t)
+    pool.emplace_back (work);
+  work ();
+  for (auto &th : pool)
+    th.join ();
+}
+
+/* One level of a product tree.  Every level takes about as much space as
+   the moduli themselves, so the whole tree needs log k times that.  When
+   that doesn't fit, levels are written out to a temporary file, and read
+   back a node at a time by the remainder tree.  */
+
+class tree_level {
+public:
+  tree_level (std::vector<natural> nodes, bool spill)
+  {
+    if (!spill || !(file_ = std::tmpfile ()))
+      {
+	nodes_ = std::move (nodes);
+	return;
+      }
+    offsets_.push_back (0);
+    for (const natural &x : nodes)
+      {
+	auto l = x.limbs ();
+	if (std::fwrite (l.data (), sizeof (limb), l.size (), file_)
+	    != l.size ())
+	  std::abort ();
+	offsets_.push_back (offsets_.back () + l.size ());
+      }
+    std::fflush (file_);
+  }
+
+  tree_level (const tree_level &) = delete;
+  tree_level (tree_level &&o)
+    : nodes_(std::move (o.nodes_)), offsets_(std::move (o.offsets_)),
+      file_(std::exchange (o.file_, nullptr))
+  {
+  }
+
+  ~tree_level ()
+  {
+    if (file_)
+      std::fclose (file_);
+  }
+
+  std::size_t size () const
+  {
+    return file_ ? offsets_.size () - 1 : nodes_.size ();
+  }
+
+  natural operator[] (std::size_t i) const
+  {
+    if (!file_)
+      return nodes_[i];
+    std::vector<limb> l (offsets_[i + 1] - offsets_[i]);
+    std::lock_guard<std::mutex> lock (mutex_);
+    if (std::fseek (file_, long (offsets_[i] * sizeof (limb)), SEEK_SET)
+	|| std::fread (l.data (), sizeof (limb), l.size (), file_)
+	   != l.size ())
+      std::abort ();
+    return natural (std::move (l));
+  }
+
+private:
+  std::vector<natural> nodes_;
+  std::vector<std::size_t> offsets_;
+  std::FILE *file_ = nullptr;
+  mutable std::mutex mutex_;
+};
+
+/* Return gcd (n_i, product of the other moduli) for each of MODULI.
+   Levels of the product tree beyond the first MEMORY_LIMIT bytes go to
+   disk.  */
+
+template<euclidean_domain K>
+static std::vector<K>
+batch_gcd (std::span<const K> moduli,
+	   std::size_t memory_limit = std::size_t (-1),
+	   unsigned threads = std::max (1u, std::thread::hardware_concurrency ()))
+{
+  const std::size_t k = moduli.size ();
+  if (k == 0)
+    return {};
+
+  /* The product tree, leaves first.  */
+  std::vector<tree_level> tree;
+  std::vector<natural> level (k);
+  parallel_for (k, threads, [&] (std::size_t i) {
+    level[i] = to_natural (moduli[i]);
+  });
+  std::size_t bytes = 0;
+  while (true)
+    {
+      for (const natural &x : level)
+	bytes += x.size () * sizeof (limb);
+      std::vector<natural> up ((level.size () + 1) / 2);
+      if (level.size () > 1)
+	parallel_for (up.size (), threads, [&] (std::size_t i) {
+	  up[i] = (2 * i + 1 < level.size ()
+		   ? level[2 * i] * level[2 * i + 1] : level[2 * i]);
+	});
+      const bool root = level.size () == 1;
+      tree.emplace_back (std::move (level), bytes > memory_limit);
+      if (root)
+	break;
+      level = std::move (up);
+    }
+
+  /* The remainder tree.  P mod P^2 is P itself.  */
+  std::vector<natural> rem { tree.back ()[0] };
+  for (std::size_t l = tree.size () - 1; l-- > 0; )
+    {
+      std::vector<natural> down (tree[l].size ());
+      parallel_for (down.size (), threads, [&] (std::size_t i) {
+	const natural x = tree[l][i];
+	down[i] = rem[i / 2] % (x * x);
+      });
+      rem = std::move (down);
+    }
+
+  std::vector<K> g (k);
+  parallel_for (k, threads, [&] (std::size_t i) {
+    using std::gcd;
+    g[i] = gcd (moduli[i],
+		from_natural<K> (rem[i] / to_natural (moduli[i])));
+  });
+  return g;
+}
+
+/* Audit the public keys PUBS: return the index and the private key of
+   every key whose modulus shares a prime with another one.  When both
+   primes are shared, batch_gcd gives back N itself, and we look for the
+   culprits among the other moduli one at a time; there are few such
+   keys.  A modulus that appears more than once can't be factored this
+   way.  */
+
+template<euclidean_domain K>
+static std::vector<std::pair<std::size_t, private_key<K>>>
+weak_keys (std::span<const std::pair<K, K>> pubs,
+	   std::size_t memory_limit = std::size_t (-1))
+{
+  using std::gcd;
+  std::vector<K> moduli;
+  for (const auto &[n, e] : pubs)
+    moduli.push_back (n);
+  const std::vector<K> g = batch_gcd (std::span<const K> (moduli),
+				      memory_limit);
+
+  std::vector<std::pair<std::size_t, private_key<K>>> weak;
+  for (std::size_t i = 0; i < pubs.size (); ++i)
+    {
+      const auto &[n, e] = pubs[i];
+      K p = g[i];
+      if (p == K (1))
+	continue;
+      for (std::size_t j = 0; p == n && j < moduli.size (); ++j)
+	if (K h = gcd (n, moduli[j]); h != K (1) && h != n)
+	  p = h;
+      if (p == n)
+	continue;
+      const K q = n / p;
+      if (p == q || !(gcd (e, carmichael_fn (p, q)) == K (1)))
+	continue;
+      weak.emplace_back (i, make_private_key (p, q, e));
+    }
+  return weak;
 }
 
 int
@@ -193,7 +691,7 @@ main ()
 {
   auto [pub, prv] = generate_keys ();
   std::cout << "pub: (" << pub.first << ", " << pub.second << ")\n";
-  std::cout << "prv: (" << prv.first << ", " << prv.second << ")\n";
+  std::cout << "prv: (" << prv.n << ", " << prv.d << ")\n";
 
   /* Message M should be padded; see PKCS#1 and OAEP .  */
   int m = 65;
@@ -207,4 +705,140 @@ main ()
      λ(n), and figure out D.  */
   std::cout << "attempting to crack...\n";
   std::cout << "original message: " << crack (c, pub) << "\n";
+
+  auto f = factor (9223372036854775807L);
+  assert ((f == std::vector<long>{ 7, 7, 73, 127, 337, 92737, 649657 }));
+  f = factor (4611686014132420609L);
+  assert ((f == std::vector<long>{ 2147483647, 2147483647 }));
+  assert (factor_composite (1000000016000000063L) == 1000000007L);
+  /* Above 2^63, where x^2 + C no longer fits before it's reduced.  */
+  auto fu = factor (18446743979220271189ul);
+  assert ((fu == std::vector<std::uint64_t>{ 4294967279, 4294967291 }));
+  fu = factor (18446744066127207559ul);
+  assert ((fu == std::vector<std::uint64_t>{ 1000000007, 18446743937 }));
+  fu = factor (18446713285223915707ul);
+  assert ((fu == std::vector<std::uint64_t>{ 2097133, 2097143, 4194353 }));
+
+  /* Pollard's rho makes short work of a 60-bit modulus too.  */
+  auto [pub2, prv2] = generate_keys<key_type> (1000000007, 1100000009);
+  std::cout << "pub: (" << pub2.first << ", " << pub2.second << ")\n";
+  c = encrypt (m, pub2);
+  assert (decrypt (c, prv2) == m);
+  assert (decrypt (c, std::pair{prv2.n, prv2.d}) == m);
+  std::cout << "cracked: " << crack (c, pub2) << "\n";
+  assert (crack (c, pub2) == m);
+
+  /* A 2048-bit key, from two random 1024-bit starting points.  */
+  big_key_type p0 = random_wide_uint<2048> (1024) | 1;
+  big_key_type q0 = random_wide_uint<2048> (1024) | 1;
+  auto [pub3, prv3] = generate_keys (p0, q0);
+  std::cout << "pub: " << bit_width (pub3.first) << "-bit modulus, e = "
+	    << pub3.second << "\n";
+  big_key_type c3 = encrypt (m, pub3);
+  assert (decrypt (c3, prv3) == m);
+  assert (c3 == modular_pow (big_key_type (m), pub3.second, pub3.first));
+  std::cout << "decrypted " << decrypt (c3, prv3) << "\n";
+
+  /* CRT and plain decryption agree, one at a time and in a batch.  */
+  std::vector<big_key_type> cs, ms (8);
+  for (int i = 0; i < 8; ++i)
+    cs.push_back (random_wide_uint<2048> (2000));
+  decrypt (std::span<const big_key_type> (cs), prv3, std::span (ms));
+  for (int i = 0; i < 8; ++i)
+    {
+      assert (ms[i] == decrypt (cs[i], std::pair{prv3.n, prv3.d}));
+      assert (encrypt (ms[i], pub3) == cs[i]);
+    }
+
+  /* Invert many values modulo the same big prime at once.  */
+  std::vector<big_key_type> invs = ms;
+  assert (mult_inv_mod_batch (std::span<big_key_type> (invs), prv3.p));
+  for (std::size_t i = 0; i < ms.size (); ++i)
+    assert (invs[i] == mult_inv_mod (ms[i] % prv3.p, prv3.p));
+  invs.push_back (prv3.p);
+  assert (!mult_inv_mod_batch (std::span<big_key_type> (invs), prv3.p));
+  /* Signed and unsigned words too, where extended_gcd's coefficient
+     can come out negative.  */
+  const std::vector<long> xs = { 2, 3, 10, 999999999, 123456789 };
+  std::vector<long> sinvs = xs;
+  std::vector<std::uint64_t> uinvs (xs.begin (), xs.end ());
+  assert (mult_inv_mod_batch (std::span<long> (sinvs), 1000000007L));
+  assert (mult_inv_mod_batch (std::span<std::uint64_t> (uinvs),
+			      std::uint64_t (1000000007)));
+  for (std::size_t i = 0; i < xs.size (); ++i)
+    {
+      assert (sinvs[i] >= 0 && sinvs[i] < 1000000007L
+	      && sinvs[i] * xs[i] % 1000000007L == 1);
+      assert (uinvs[i] == std::uint64_t (sinvs[i]));
+    }
+
+  /* A batch of 128-bit keys, some of them sharing primes.  */
+  using mid_key_type = wide_uint<128>;
+
+  /* An even modulus too wide for its products to fit in 128 bits: they
+     need the full product of mul_mod.  */
+  const mid_key_type m5 = (mid_key_type (1) << 127) + 2;
+  const mid_key_type b5 = (mid_key_type (1) << 100) + 12345;
+  mid_key_type r5 = 1;
+  for (int i = 0; i < 5; ++i)
+    r5 = mul_mod (r5, b5, m5);
+  assert (modular_pow (b5, mid_key_type (5), m5) == r5);
+  assert (r5 == ((mid_key_type (1922276977712558821u) << 64)
+		 | mid_key_type (14550613133270170695u)));
+  auto prime_near = [] (std::uint64_t n) {
+    n |= 1;
+    while (!prime_p (n))
+      n += 2;
+    return mid_key_type (n);
+  };
+  std::vector<mid_key_type> ps;
+  for (int i = 0; i < 400; ++i)
+    ps.push_back (prime_near (witness_rand () >> 2));
+  std::vector<std::pair<mid_key_type, mid_key_type>> pubs;
+  for (int i = 0; i < 200; ++i)
+    pubs.emplace_back (ps[2 * i] * ps[2 * i + 1], 65537);
+  /* Key 150 reuses a prime of key 10, key 77 is key 3 again, and key 99
+     is made of a prime from key 20 and one from key 21.  */
+  pubs[150].first = ps[20] * ps[301];
+  pubs[77] = pubs[3];
+  pubs[99].first = ps[40] * ps[43];
+
+  const auto weak
+    = weak_keys (std::span<const std::pair<mid_key_type, mid_key_type>>
+		 (pubs));
+  std::vector<std::size_t> found;
+  for (const auto &[i, key] : weak)
+    {
+      found.push_back (i);
+      assert (key.n == pubs[i].first);
+      mid_key_type c4 = encrypt (m, pubs[i]);
+      assert (decrypt (c4, key) == m);
+    }
+  assert ((found == std::vector<std::size_t>{ 10, 20, 21, 99, 150 }));
+  std::cout << "found " << weak.size () << " weak keys out of "
+	    << pubs.size () << "\n";
+
+  /* Spilling the tree to disk doesn't change anything.  */
+  std::vector<mid_key_type> moduli;
+  for (const auto &pub : pubs)
+    moduli.push_back (pub.first);
+  const auto g = batch_gcd (std::span<const mid_key_type> (moduli));
+  assert (batch_gcd (std::span<const mid_key_type> (moduli), 0, 3) == g);
+  assert (g[3] == moduli[3] && g[77] == moduli[77] && g[0] == 1);
+
+  /* Numbers long enough for natural's multiplication to go through the
+     number-theoretic transform, which the moduli above never are.  The
+     product agrees with Karatsuba's on the same limbs, and divides
+     back.  */
+  constexpr std::size_t nl = ntt_threshold + 2000;
+  std::vector<limb> la (nl), lb (nl);
+  for (std::size_t i = 0; i < nl; ++i)
+    la[i] = witness_rand (), lb[i] = witness_rand ();
+  const natural na (la), nb (lb);
+  const natural nab = na * nb;
+  std::vector<limb> kprod (2 * nl), ktmp (6 * nl);
+  mp_mul_n (kprod.data (), la.data (), lb.data (), nl, ktmp.data ());
+  assert (nab == natural (kprod));
+  assert (nab / na == nb && !(nab % na));
+  assert ((na * na) / na == na);
 }
@@ -1,29 +1,40 @@
-// Compute prime_p at compile time using templates.
+// Compute prime_p at compile time.
+// Use -std=c++20.
 
-template<unsigned int P, unsigned int D>
-struct do_prime {
-  static constexpr bool value = (P % D) && do_prime<P, D - 1>::value;
-};
+#include <concepts>
+#include <cstdint>
 
-template<unsigned int P>
-struct do_prime<P, 2> {
-  static constexpr bool value = (P % 2 != 0);
-};
+/* This used to recurse through do_prime<P, D - 1> for every D from P / 2
+   down to 2, which ran into the template instantiation depth limit for
+   any prime above a few thousand.  A constexpr function has no such
+   limit: trial division by 2, 3 and then 6k ± 1 up to sqrt (N) takes
+   about sqrt (N) / 3 steps, so every 32-bit N is fine and the compiler's
+   constexpr operation limit only kicks in around 2^50.  */
+
+template<std::unsigned_integral I>
+constexpr bool
+constexpr_prime_p (I n)
+{
+  if (n <= 3)
+    return n > 1;
+  if (n % 2 == 0 || n % 3 == 0)
+    return false;
+  /* I * I <= N without overflowing.  */
+  for (I i = 5; i <= n / i; i += 6)
+    if (n % i == 0 || n % (i + 2) == 0)
+      return false;
+  return true;
+}
 
-template<unsigned int P>
+template<std::uint64_t P>
 struct prime_p {
-  static constexpr bool value = do_prime<P, P / 2>::value;
+  static constexpr bool value = constexpr_prime_p (P);
 };
 
-template<>
-struct prime_p<0> { static constexpr bool value = false; };
-template<>
-struct prime_p<1> { static constexpr bool value = false; };
-template<>
-struct prime_p<2> { static constexpr bool value = true; };
-template<>
-struct prime_p<3> { static constexpr bool value = true; };
+template<std::uint64_t P>
+inline constexpr bool prime_p_v = prime_p<P>::value;
 
+static_assert(!prime_p<0>::value);
 static_assert(!prime_p<1>::value);
 static_assert(prime_p<2>::value);
 static_assert(prime_p<3>::value);
@@ -36,3 +47,13 @@ static_assert(!prime_p<9>::value);
 static_assert(!prime_p<10>::value);
 static_assert(prime_p<11>::value);
 static_assert(!prime_p<12>::value);
+static_assert(!prime_p<25>::value);
+static_assert(!prime_p<49>::value);
+static_assert(prime_p_v<7919>);
+static_assert(prime_p_v<1000000007>);
+static_assert(prime_p_v<2147483647>);
+static_assert(prime_p_v<4294967291>);
+static_assert(!prime_p_v<4294967297>);	// 641 * 6700417
+static_assert(!prime_p_v<4294967295>);
+static_assert(constexpr_prime_p (65521u));
+static_assert(!constexpr_prime_p (65535u));